@@ -11,6 +11,7 @@
 #include "state.h"
 #include "misc.h"
 #include "cleanup.h"
+#include "sparse.h"
 
 // Public tasks
 TASK(TASK_UID_NONLINEAR_OFFSET + 1, task_pool);
@@ -21,6 +22,7 @@ TASK(TASK_UID_NONLINEAR_OFFSET + 4, task_transpose);
 void task_pool() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	act_dense(src);
 	uint16_t layers = MAT_GET_DIM(src, 0);
 	uint16_t rows = MAT_GET_DIM(src, 1);
 	uint16_t cols = MAT_GET_DIM(src, 2);
@@ -28,6 +30,7 @@ void task_pool() {
 	for(uint16_t i = 0; i < layers; i++) {
 		for(uint16_t j = 0; j < rows; j += params.stride[1]) {
 			for(uint16_t k = 0; k < cols; k += params.stride[2]) {
+				prof_iter(1);
 				fixed max = MAT_GET(src, i, j, k);
 				for(uint16_t l = 0; l < params.size[1]; l ++) {
 					for(uint16_t m = 0; m < params.size[2]; m ++) {
@@ -40,6 +43,7 @@ void task_pool() {
 			}
 		}
 	}
+	pool_hop();
 	POP_STACK(mat_stack, 2);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -68,12 +72,12 @@ void task_filter() {
 void task_relu() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
-	uint16_t total_elements = MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1);
+	idx_t total_elements = (idx_t)MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1);
 	if(src->len_dims == 3) {
 		total_elements *= MAT_GET_DIM(src, 2);
 	}
 	fixed max = F_LIT(0.0);
-	for(uint16_t i = 0; i < total_elements; i++) {
+	for(idx_t i = 0; i < total_elements; i++) {
 		max = *(src->data + i);
 		*(dest->data + i) = (F_LT(max, F_LIT(0.0))) ? F_LIT(0.0) : max;
 	}
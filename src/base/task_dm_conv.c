@@ -10,6 +10,7 @@
 #include "misc.h"
 #include "profile.h"
 #include "cleanup.h"
+#include "sparse.h"
 
 TASK(TASK_UID_BLAS_OFFSET + 6, task_dm_conv);
 
@@ -19,40 +20,58 @@ void task_dm_conv() {
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *filter = PEEK_STACK(mat_stack, 2);
 
-	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t batch = BATCH_LEN;
+	uint16_t rows = MAT_GET_DIM(dest, 0) / batch;
 	uint16_t cols = MAT_GET_DIM(dest, 1);
+	uint16_t src_rows = MAT_GET_DIM(src, 1) / batch;
+	idx_t src_frame = (idx_t)src_rows * MAT_GET_DIM(src, 2);
+	idx_t dest_frame = (idx_t)rows * cols;
 
 	uint16_t flayers = MAT_GET_DIM(filter, 0);
 	uint16_t frows = MAT_GET_DIM(filter, 1);
 	uint16_t fcols = MAT_GET_DIM(filter, 2);
-	for(uint16_t k = 0; k < flayers; k++) {
-		for(uint16_t l = 0; l < frows; l++) {
-			for(uint16_t n = 0; n < fcols; n++) {
-				uint16_t i_stride = 0;
-				for(uint16_t i = 0; 
-					i < rows * params.stride[1]; i += params.stride[1]) {
-					uint16_t j_stride = 0;
-					for(uint16_t j = 0;
-						j < cols * params.stride[2]; j += params.stride[2]) {
-						fixed w = 0;
-						if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
-							j + n < MAT_GET_DIM(src, 2))) {
-							w = F_MUL(MAT_GET(filter, k, l, n), 
-								MAT_GET(src, k, i + l, j + n));
-						}
-						if(k == 0 && l == 0 && n == 0) { // Zero
-							MAT_SET(dest, w, i_stride, j_stride);
-							j_stride++;
+	bool packed = act_is_packed(src);
+	uint16_t i_stride = 0;
+	for(uint16_t i = 0; i < rows * params.stride[1]; i += params.stride[1]) {
+		uint16_t j_stride = params.col0;
+		for(uint16_t j = params.col0 * params.stride[2]; 
+			j < cols * params.stride[2]; j += params.stride[2]) {
+			// Passes of up to CONFIG_BATCH frames, one weight load each
+			for(uint16_t b0 = 0; b0 < batch; b0 += CONFIG_BATCH) {
+				uint16_t len = (batch - b0 < CONFIG_BATCH) ? batch - b0 : CONFIG_BATCH;
+				acc_t w[CONFIG_BATCH];
+				for(uint16_t b = 0; b < len; b++) w[b] = 0;
+				for(uint16_t k = 0; k < flayers; k++) {
+					for(uint16_t l = 0; l < frows; l++) {
+						if(packed) {
+							for(uint16_t b = 0; b < len && i + l < src_rows; b++) {
+								w[b] += act_dot(src, k * MAT_GET_DIM(src, 1) + 
+									(b0 + b) * src_rows + i + l, j,
+									MAT_PTR(filter, k, l, 0), fcols);
+							}
 							continue;
 						}
-						w = F_ADD(w, MAT_GET(dest, i_stride, j_stride));
-						MAT_SET(dest, w, i_stride, j_stride);
-						j_stride++;
+						for(uint16_t n = 0; n < fcols; n++) {
+							if(!params.same_padding || (i + l < src_rows && 
+								j + n < MAT_GET_DIM(src, 2))) {
+								fixed f = MAT_GET(filter, k, l, n);
+								fixed *src_ptr = 
+									MAT_PTR(src, k, i + l, j + n) + b0 * src_frame;
+								for(uint16_t b = 0; b < len; b++) {
+									w[b] += ACC_MUL(f, src_ptr[b * src_frame]);
+								}
+							}
+						}
 					}
-					i_stride++;
+				}
+				fixed *dest_ptr = MAT_PTR(dest, i_stride, j_stride) + b0 * dest_frame;
+				for(uint16_t b = 0; b < len; b++) {
+					dest_ptr[b * dest_frame] = acc_round(w[b]);
 				}
 			}
+			j_stride++;
 		}
+		i_stride++;
 	}
 
 	POP_STACK(mat_stack, 3);
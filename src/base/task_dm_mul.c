@@ -24,12 +24,12 @@ void task_dm_mul() {
 	prof_pulse(0x20);
 	for(uint16_t i = 0; i < rows; i++) {
 		for(uint16_t k = 0; k < dcols; k++) {
-			fixed w = 0;
+			prof_iter(1);
+			acc_t w = (acc_t)FC_BIAS(i) * F_ONE;
 			for(uint16_t j = 0; j < cols; j++) {
-				fixed tmp = F_MUL(MAT_GET(filter, i, j), MAT_GET(src, j, k));
-				w = F_ADD(w, tmp);
+				w += ACC_MUL(MAT_GET(filter, i, j), MAT_GET(src, j, k));
 			}
-			MAT_SET(dest, w, i, k);
+			MAT_SET(dest, FC_RELU(acc_round(w)), i, k);
 		}
 	}
 	prof_pulse(0x20);
@@ -0,0 +1,49 @@
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "blas.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "profile.h"
+#include "cleanup.h"
+#include "sparse.h"
+
+TASK(TASK_UID_BLAS_OFFSET + 7, task_dmv_mul);
+
+// Dense matrix vector multiplication. Rows are written whole, the row count
+// persists in scratch.
+void task_dmv_mul() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	uint16_t rows = MAT_GET_DIM(filter, 0);
+	uint16_t cols = MAT_GET_DIM(filter, 1);
+	uint16_t nz = nz_build(src);
+	prof_pulse(0x20);
+	for(uint16_t i = CUR_SCRATCH[0]; i < rows; i = ++CUR_SCRATCH[0]) {
+		prof_persist();
+		prof_iter(1);
+		fixed *filter_ptr = MAT_PTR(filter, i, 0);
+		fixed *src_ptr = src->data;
+		acc_t w = (acc_t)FC_BIAS(i) * F_ONE;
+		if(nz != NZ_DENSE) { // Only the columns of nonzero activations
+			for(uint16_t n = 0; n < nz; n++) {
+				uint16_t j = nz_idx[n];
+				w += ACC_MUL(filter_ptr[j], src_ptr[j]);
+			}
+		} else {
+			for(uint16_t j = 0; j < cols; j++) {
+				w += ACC_MUL(*filter_ptr++, *src_ptr++);
+			}
+		}
+		MAT_SET(dest, FC_RELU(acc_round(w)), i, 0);
+	}
+	prof_pulse(0x20);
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
\ No newline at end of file
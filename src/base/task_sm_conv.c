@@ -19,8 +19,10 @@ void task_sm_conv() {
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *filter = PEEK_STACK(mat_stack, 2);
 
-	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t batch = BATCH_LEN;
+	uint16_t rows = MAT_GET_DIM(dest, 0) / batch;
 	uint16_t cols = MAT_GET_DIM(dest, 1);
+	uint16_t src_rows = MAT_GET_DIM(src, 1) / batch;
 	uint16_t frows = filter->sparse.dims[1];
 	uint16_t fcols = filter->sparse.dims[2];
 	uint16_t total_elements = MAT_GET_DIM(filter, 0);
@@ -37,21 +39,27 @@ void task_sm_conv() {
 		// PRINTF("\r\n k: %u l: %u n: %u idx: %u pos: %u val: %i", 
 		// 	k, l, n, idx, pos, MAT_GET(filter, pos));
 		fixed f = MAT_GET(filter, pos);
-		fixed *dest_ptr = MAT_PTR(dest, 0, 0);
-		for(uint16_t i = 0; i < rows * params.stride[1]; i += params.stride[1]) {
-			fixed *src_ptr = MAT_PTR(src, k, i + l, n);
-			for(uint16_t j = 0; j < cols * params.stride[2]; j += params.stride[2]) {
-				fixed w = 0;
-				if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
-					j + n < MAT_GET_DIM(src, 2))) {
-					w = F_MUL(f, *src_ptr);
+		uint16_t j0 = params.col0 * params.stride[2];
+		for(uint16_t b = 0; b < batch; b++) { // Frames follow in dest
+			for(uint16_t i = 0; i < rows * params.stride[1]; i += params.stride[1]) {
+				fixed *dest_ptr = 
+					MAT_PTR(dest, b * rows + i / params.stride[1], params.col0);
+				fixed *src_ptr = MAT_PTR(src, k, b * src_rows + i + l, j0 + n);
+				for(uint16_t j = j0; j < cols * params.stride[2]; 
+					j += params.stride[2]) {
+					prof_iter(1);
+					fixed w = 0;
+					if(!params.same_padding || (i + l < src_rows && 
+						j + n < MAT_GET_DIM(src, 2))) {
+						w = F_MUL(f, *src_ptr);
+					}
+					if(!zero) {
+						w = F_ADD(w, *dest_ptr); // Zero
+					}
+					*dest_ptr = w;
+					dest_ptr++;
+					src_ptr += params.stride[2];
 				}
-				if(!zero) {
-					w = F_ADD(w, *dest_ptr); // Zero
-				}
-				*dest_ptr = w;
-				dest_ptr++;
-				src_ptr += params.stride[2];
 			}
 		}
 		zero = 0;
@@ -60,15 +60,13 @@ void task_svm_mul() {
 		fixed *filter_ptr = MAT_PTR(filter, start);
 		fixed *dest_ptr = MAT_PTR(dest, i, 0);
 		uint16_t *offset = filter->sparse.offsets + start;
+		fixed w = FC_BIAS(i);
 		for(uint16_t j = start; j < end; j++) {
-			fixed w = F_MUL(MAT_GET(src, *offset, 0), *filter_ptr++);
-			if(j != start) {
-				w = F_ADD(w, *dest_ptr);
-			}
-			*dest_ptr = w;
+			prof_iter(1);
+			w = F_ADD(w, F_MUL(MAT_GET(src, *offset, 0), *filter_ptr++));
 			offset++;
 		}
-		dest_ptr++;
+		*dest_ptr = FC_RELU(w);
 	}
 	prof_pulse(0x10);
 	POP_STACK(mat_stack, 3);
@@ -12,6 +12,8 @@ TASK(404, task_cleanup);
 static __fram task_t *last_task;
 void task_cleanup() {
 	// PRINTF("\r\nCleaning Up %u", last_task->info.return_task->idx);
+	trace(TRACE_CLEANUP, last_task->idx);
+	prof_cleanup(last_task->idx);
 	memset(last_task->info.scratch, 0, sizeof(uint16_t) * SCRATCH_SIZE);
 	transition_to(last_task->info.return_task);
 }
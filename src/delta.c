@@ -0,0 +1,138 @@
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "mem.h"
+#include "blas.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "profile.h"
+#include "cleanup.h"
+#include "sparse.h"
+#include "delta.h"
+
+TASK(TASK_UID_DELTA_OFFSET + 0, task_delta_mul);
+
+static __fram delta_t *deltas;
+static __fram uint16_t len_deltas;
+
+void delta_register(delta_t *table, uint16_t len) {
+	deltas = table;
+	len_deltas = len;
+}
+
+delta_t *delta_find(mat_t *w) {
+	for(uint16_t i = 0; i < len_deltas; i++) {
+		if(deltas[i].mat == w) return &deltas[i];
+	}
+	return NULL;
+}
+
+// Change of input j since the outputs were last updated, 0 within thresh.
+// Wide, the difference of two fixed can overflow one.
+static inline acc_t delta_in(delta_t *d, mat_t *src, uint16_t j) {
+	acc_t dx = (acc_t)src->data[j] - d->x[j];
+	if(dx <= d->thresh && dx >= -(acc_t)d->thresh) return 0;
+	return dx;
+}
+
+// Weights times the input change of a registered layer, added to the outputs
+// of the last run. Dense weights gather the changed columns into nz_idx first
+// (scratch 2 keeps how many), CSR weights check each entry's column. Rows go
+// from one half of acc to the other so a row can be redone after a reboot, x
+// is caught up and the halves swapped once all rows are written. Bias and
+// ReLU as for task_dmv_mul.
+void task_delta_mul() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	delta_t *d = delta_find(filter);
+
+	bool csr = filter->sparse.len_dims > 0;
+	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t cols = MAT_GET_DIM(src, 0);
+	if(CUR_SCRATCH[0] == 0) {
+		uint16_t n = NZ_DENSE;
+		if(!csr && cols <= CONFIG_NZ_LEN) {
+			n = 0;
+			for(uint16_t j = 0; j < cols; j++) {
+				if(delta_in(d, src, j) != 0) nz_idx[n++] = j;
+			}
+		}
+		PRINTF("\r\n     Delta of %u inputs", n);
+		scratch_bak[0] = 1;
+		scratch_bak[2] = n;
+		write_to_gbuf((uint8_t *)(scratch_bak),
+			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+		write_to_gbuf((uint8_t *)(scratch_bak + 2),
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	uint16_t nz = CUR_SCRATCH[2];
+	if(CUR_SCRATCH[0] == 1) {
+		acc_t *last = d->acc + d->cur * rows;
+		acc_t *next = d->acc + (d->cur ^ 1) * rows;
+		prof_pulse(0x20);
+		for(uint16_t i = CUR_SCRATCH[1]; i < rows; i = ++CUR_SCRATCH[1]) {
+			prof_iter(1);
+			acc_t w = last[i];
+			if(csr) {
+				uint16_t start = filter->sparse.sizes[i];
+				uint16_t end = filter->sparse.sizes[i + 1];
+				fixed *filter_ptr = MAT_PTR(filter, start);
+				uint16_t *offset = filter->sparse.offsets + start;
+				for(uint16_t j = start; j < end; j++) {
+					acc_t dx = delta_in(d, src, *offset++);
+					fixed f = *filter_ptr++;
+					if(dx == 0) continue;
+					w += ACC_MUL(f, dx);
+				}
+			} else if(nz != NZ_DENSE) {
+				fixed *filter_ptr = MAT_PTR(filter, i, 0);
+				for(uint16_t n = 0; n < nz; n++) {
+					uint16_t j = nz_idx[n];
+					acc_t dx = (acc_t)src->data[j] - d->x[j];
+					w += ACC_MUL(filter_ptr[j], dx);
+				}
+			} else {
+				fixed *filter_ptr = MAT_PTR(filter, i, 0);
+				for(uint16_t j = 0; j < cols; j++) {
+					w += ACC_MUL(filter_ptr[j], delta_in(d, src, j));
+				}
+			}
+			next[i] = w;
+			MAT_SET(dest, FC_RELU(acc_round(w + (acc_t)FC_BIAS(i) * F_ONE)),
+				i, 0);
+		}
+		prof_pulse(0x20);
+		scratch_bak[0] = 2;
+		write_to_gbuf((uint8_t *)(scratch_bak),
+			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	if(CUR_SCRATCH[0] == 2) {
+		// Catching up x is safe to redo, a caught up input reads as unchanged
+		if(nz != NZ_DENSE) {
+			for(uint16_t n = 0; n < nz; n++) {
+				d->x[nz_idx[n]] = src->data[nz_idx[n]];
+			}
+		} else {
+			for(uint16_t j = 0; j < cols; j++) {
+				if(delta_in(d, src, j) != 0) d->x[j] = src->data[j];
+			}
+		}
+		scratch_bak[0] = 3;
+		scratch_bak[3] = d->cur ^ 1;
+		write_to_gbuf((uint8_t *)(scratch_bak),
+			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+		write_to_gbuf((uint8_t *)(scratch_bak + 3),
+			(uint8_t *)(&d->cur), sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
@@ -23,9 +23,16 @@ void task_sm_conv() {
 	mat_t *inter = buffer;
 	mat_t *filter = PEEK_STACK(mat_stack, 2);
 
-	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t batch = BATCH_LEN;
+	uint16_t rows = MAT_GET_DIM(dest, 0) / batch;
 	uint16_t cols = MAT_GET_DIM(dest, 1);
-	MAT_RESHAPE(inter, rows, cols);
+	uint16_t src_rows = MAT_GET_DIM(src, 1) / batch;
+	if((uint32_t)rows * batch * cols > CONFIG_MAT_BUF_SIZE) {
+		// MAT_BUFFER(1) and (2) follow, the latter stages streamed weights
+		PRINTF("\r\n Batch of %u frames overruns the sm_conv buffer", batch);
+		while(1) {}
+	}
+	MAT_RESHAPE(inter, rows * batch, cols); // The plane of every frame
 
 	uint16_t frows = filter->sparse.dims[1];
 	uint16_t fcols = filter->sparse.dims[2];
@@ -39,92 +46,106 @@ void task_sm_conv() {
 
 	uint16_t pos = CUR_SCRATCH[0];
 	uint16_t idx = CUR_SCRATCH[1];
-	prof_inc("ld", 2, 2);
+	prof_inc(ld, 2, 2);
 	bool zero = false;
 	if(pos == 0) {
 		zero = true;
 		idx += filter->sparse.offsets[pos];
-		prof_inc("add", 1, 1);
-		prof_inc("ld", 1, 1);
+		prof_inc(add, 1, 1);
+		prof_inc(ld, 1, 1);
 	}
 	uint16_t k = idx / (fcols * frows); // Layers
 	uint16_t l = (idx % (fcols * frows)) / fcols; // Rows
 	uint16_t n = idx % fcols; // Cols
-	prof_inc("mul", 6, 6);
+	prof_inc(mul, 6, 6);
 
-	uint16_t i_stride = CUR_SCRATCH[3] / params.stride[1];
-	uint16_t j_stride = CUR_SCRATCH[4] / params.stride[2];
-	prof_inc("ld", 4, 4);
 	fixed f = MAT_GET(filter, pos);
-	prof_inc("MAT_GET_1D", 1, 1);
-	prof_inc("MAT_GET_2D", 2, 2);
-	fixed *inter_ptr = MAT_PTR(inter, i_stride, j_stride);
-	fixed *dest_ptr = MAT_PTR(dest, i_stride, j_stride);
+	prof_inc(MAT_GET_1D, 1, 1);
 	prof_pulse(0x1);
-	for(uint16_t i = CUR_SCRATCH[3]; 
-		i < rows * params.stride[1]; i = (CUR_SCRATCH[3] += params.stride[1])) {
-		prof_inc("loop_add", 1, 1);	
-		fixed *src_ptr = MAT_PTR(src, k, i + l, CUR_SCRATCH[4] + n);
-		prof_inc("MAT_GET_3D", 1, 1);	
-		prof_inc("add", 2, 2);
-		for(uint16_t j = CUR_SCRATCH[4]; 
-			j < cols * params.stride[2]; j = (CUR_SCRATCH[4] += params.stride[2])) {
-			prof_inc("loop_add", 1, 1);	
-			fixed w = 0;
-			prof_inc("add", 2, 2);
-			if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
-				j + n < MAT_GET_DIM(src, 2))) {
-				w = F_MUL(f, *src_ptr);
-				prof_inc("ld", 1, 1);
-				prof_inc("F_MUL", 1, 1);
-			}
-			if(!zero) {
-				w = F_ADD(w, *inter_ptr); // Zero
-				prof_inc("ld", 1, 1);
-				prof_inc("F_ADD", 1, 1);
-				prof_inc("inc", 1, 1);
-				inter_ptr++;
+	// The weight stays put across the frames, the frame persists in scratch
+	// Streaming runs start at params.col0, the columns before it are kept
+	uint16_t j0 = params.col0 * params.stride[2];
+	if(CUR_SCRATCH[4] < j0) CUR_SCRATCH[4] = j0;
+	for(uint16_t b = CUR_SCRATCH[7]; b < batch; b = ++CUR_SCRATCH[7]) {
+		for(uint16_t i = CUR_SCRATCH[3]; 
+			i < rows * params.stride[1]; i = (CUR_SCRATCH[3] += params.stride[1])) {
+			prof_inc(loop_add, 1, 1);	
+			uint16_t i_stride = b * rows + i / params.stride[1];
+			uint16_t j_stride = CUR_SCRATCH[4] / params.stride[2];
+			prof_inc(ld, 4, 4);
+			prof_inc(MAT_GET_2D, 2, 2);
+			fixed *inter_ptr = MAT_PTR(inter, i_stride, j_stride);
+			fixed *dest_ptr = MAT_PTR(dest, i_stride, j_stride);
+			fixed *src_ptr = 
+				MAT_PTR(src, k, b * src_rows + i + l, CUR_SCRATCH[4] + n);
+			prof_inc(MAT_GET_3D, 1, 1);	
+			prof_inc(add, 2, 2);
+			for(uint16_t j = CUR_SCRATCH[4]; 
+				j < cols * params.stride[2]; j = (CUR_SCRATCH[4] += params.stride[2])) {
+				prof_inc(loop_add, 1, 1);	
+				prof_persist();
+				prof_iter(1);
+				fixed w = 0;
+				prof_inc(add, 2, 2);
+				if(!params.same_padding || (i + l < src_rows && 
+					j + n < MAT_GET_DIM(src, 2))) {
+					w = F_MUL(f, *src_ptr);
+					prof_inc(ld, 1, 1);
+					prof_inc(F_MUL, 1, 1);
+				}
+				if(!zero) {
+					w = F_ADD(w, *inter_ptr); // Zero
+					prof_inc(ld, 1, 1);
+					prof_inc(F_ADD, 1, 1);
+					prof_inc(inc, 1, 1);
+					inter_ptr++;
+				}
+				*dest_ptr = w;
+				prof_inc(st, 1, 1);
+				dest_ptr++;
+				prof_inc(inc, 1, 1);
+				src_ptr += params.stride[2];
+				prof_inc(add, 1, 1);
 			}
-			*dest_ptr = w;
-			prof_inc("st", 1, 1);
-			dest_ptr++;
-			prof_inc("inc", 1, 1);
-			src_ptr += params.stride[2];
-			prof_inc("add", 1, 1);
+			CUR_SCRATCH[4] = j0;
 		}
-		CUR_SCRATCH[4] = 0;
+		CUR_SCRATCH[3] = 0;
 	}
 	prof_pulse(0x1);
 
-	prof_inc("add", 2, 2);
-	prof_inc("st", 2, 2);
-	prof_inc("ld", 1, 1);
+	prof_inc(add, 2, 2);
+	prof_inc(st, 2, 2);
+	prof_inc(ld, 1, 1);
 	scratch_bak[0] = pos + 1;
 	scratch_bak[1] = idx + filter->sparse.offsets[pos + 1];
 
 	scratch_bak[2] = CUR_SCRATCH[2] ^ 0x01;
 	scratch_bak[3] = 0;
+	scratch_bak[7] = 0;
 	write_to_gbuf((uint8_t *)(scratch_bak), 
 		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
 	write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 		(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 	write_to_gbuf((uint8_t *)(scratch_bak + 3), 
 		(uint8_t *)(CUR_SCRATCH + 3), sizeof(uint16_t));
+	write_to_gbuf((uint8_t *)(scratch_bak + 7), 
+		(uint8_t *)(CUR_SCRATCH + 7), sizeof(uint16_t));
 	if(pos < total_elements - 1) {
 		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
 			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
 		transition_to(CUR_TASK);
 	}
 	if(CUR_SCRATCH[2]) {
-		for(uint16_t i = CUR_SCRATCH[5]; i < rows; i = (++CUR_SCRATCH[5])){
-			prof_inc("loop_inc", 1, 1);
+		if(CUR_SCRATCH[6] < params.col0) CUR_SCRATCH[6] = params.col0;
+		for(uint16_t i = CUR_SCRATCH[5]; i < rows * batch; i = (++CUR_SCRATCH[5])){
+			prof_inc(loop_inc, 1, 1);
 			for(uint16_t j = CUR_SCRATCH[6]; j < cols; j = (++CUR_SCRATCH[6])){
-				prof_inc("loop_inc", 1, 1);
-				prof_inc("MAT_GET_2D", 1, 1);
-				prof_inc("MAT_SET_2D", 1, 1);
+				prof_inc(loop_inc, 1, 1);
+				prof_inc(MAT_GET_2D, 1, 1);
+				prof_inc(MAT_SET_2D, 1, 1);
 				MAT_SET(inter, MAT_GET(dest, i, j), i, j);
 			}
-			CUR_SCRATCH[6] = 0;
+			CUR_SCRATCH[6] = params.col0;
 		}
 	}
 	POP_STACK(mat_stack, 3);
@@ -30,55 +30,63 @@ void task_svm_mul() {
 
 	prof_pulse(0x10);
 	for(uint16_t i = CUR_SCRATCH[0]; i < rows; i = (++CUR_SCRATCH[0])) {
-		prof_inc("loop_inc", 1, 1);
+		prof_inc(loop_inc, 1, 1);
 		uint16_t start = filter->sparse.sizes[i];
 		uint16_t end = filter->sparse.sizes[i + 1];
 		uint16_t col_idx = start + CUR_SCRATCH[1];
 		fixed *filter_ptr = MAT_PTR(filter, col_idx);
 		fixed *dest_ptr = MAT_PTR(dest, i, 0);
 		uint16_t *offset = filter->sparse.offsets + col_idx;
-		prof_inc("add", 2, 2);
-		prof_inc("MAT_GET_1D", 2, 2);
-		prof_inc("ld", 1, 1);
+		prof_inc(add, 2, 2);
+		prof_inc(MAT_GET_1D, 2, 2);
+		prof_inc(ld, 1, 1);
 		uint16_t j = CUR_SCRATCH[1];
 		if(i == pos_bak.i && j == pos_bak.j) { // Restore it i, j are the same
 			*dest_ptr = val_bak;
-			prof_inc("st", 1, 1);
-			prof_inc("ld", 1, 1);
+			prof_inc(st, 1, 1);
+			prof_inc(ld, 1, 1);
 		}
-        prof_inc("st", 1, 1);
+        prof_inc(st, 1, 1);
         if(start == end) {
             val_bak = 0;
             pos_bak.i = i;
-            *dest_ptr++ = 0;
-	        prof_inc("st", 2, 2);
-	        prof_inc("inc", 1, 1);
+            *dest_ptr++ = FC_RELU(FC_BIAS(i));
+	        prof_inc(st, 2, 2);
+	        prof_inc(inc, 1, 1);
             continue;
         }
         pos_bak.i = i;
 		for(j; j < end - start; j = (++CUR_SCRATCH[1])) {
-			prof_inc("loop_inc", 1, 1);
+			prof_inc(loop_inc, 1, 1);
+			prof_persist();
+			prof_iter(1);
 			fixed w = F_MUL(MAT_GET(src, *offset, 0), *filter_ptr++);
-			prof_inc("F_MUL", 1, 1);
-			prof_inc("MAT_GET_1D", 1, 1);
-			prof_inc("inc", 1, 1);
-			prof_inc("ld", 2, 2);
+			prof_inc(F_MUL, 1, 1);
+			prof_inc(MAT_GET_1D, 1, 1);
+			prof_inc(inc, 1, 1);
+			prof_inc(ld, 2, 2);
 			if(j == 0) {
 				val_bak = 0; // Zeroing the vector
-				prof_inc("st", 1, 1);
+				prof_inc(st, 1, 1);
+				if(params.bias != NULL) {
+					w = F_ADD(w, FC_BIAS(i));
+					prof_inc(F_ADD, 1, 1);
+				}
 			} else {
 				val_bak = *dest_ptr;
 				w = F_ADD(w, val_bak);
-				prof_inc("F_ADD", 1, 1);
-				prof_inc("ld", 1, 1);
-				prof_inc("st", 1, 1);
+				prof_inc(F_ADD, 1, 1);
+				prof_inc(ld, 1, 1);
+				prof_inc(st, 1, 1);
 			}
-			prof_inc("st", 2, 2);
-			prof_inc("inc", 1, 1);
+			prof_inc(st, 2, 2);
+			prof_inc(inc, 1, 1);
 			pos_bak.j = j;
 			*dest_ptr = w;
 			offset++;
 		}
+		// Idempotent, fine to redo after a reboot
+		if(params.relu) *dest_ptr = FC_RELU(*dest_ptr);
 		dest_ptr++;
 		CUR_SCRATCH[1] = 0;
 	}
@@ -112,40 +120,40 @@ void task_svm_mul() {
 	fixed *dest_ptr = MAT_PTR(dest, CUR_SCRATCH[0], 0);
 	prof_pulse(0x10);
 	for(uint16_t i = CUR_SCRATCH[0]; i < rows; i = (++CUR_SCRATCH[0])) {
-		prof_inc("loop_inc", 1, 1);
-		prof_inc("ld", 2, 2);
-		prof_inc("inc", 1, 1);
-		prof_inc("add", 1, 1);
+		prof_inc(loop_inc, 1, 1);
+		prof_inc(ld, 2, 2);
+		prof_inc(inc, 1, 1);
+		prof_inc(add, 1, 1);
 		if(j >= (filter->sparse.sizes[i + 1] - filter->sparse.sizes[i])) {
 			if(j == 0) {
 				*dest_ptr++ = 0;
-				prof_inc("inc", 1, 1);
-				prof_inc("st", 1, 1);
+				prof_inc(inc, 1, 1);
+				prof_inc(st, 1, 1);
 			} else {
 				*dest_ptr++ = *inter_ptr++;
-				prof_inc("inc", 2, 2);
-				prof_inc("st", 1, 1);
-				prof_inc("ld", 1, 1);
+				prof_inc(inc, 2, 2);
+				prof_inc(st, 1, 1);
+				prof_inc(ld, 1, 1);
 			}
 			continue;
 		}
-		prof_inc("add", 1, 1);
+		prof_inc(add, 1, 1);
 		uint16_t col_idx = filter->sparse.sizes[i] + j;
-		prof_inc("MAT_GET_1D", 1, 1);
+		prof_inc(MAT_GET_1D, 1, 1);
 		fixed f = MAT_GET(filter, col_idx);
-		prof_inc("MAT_GET_2D", 1, 1);
-		prof_inc("ld", 1, 1);
+		prof_inc(MAT_GET_2D, 1, 1);
+		prof_inc(ld, 1, 1);
 		fixed w = MAT_GET(src, filter->sparse.offsets[col_idx], 0);
-		prof_inc("F_MUL", 1, 1);
+		prof_inc(F_MUL, 1, 1);
 		w = F_MUL(f, w);
 		if(j != 0) {
-			prof_inc("F_ADD", 1, 1);
-			prof_inc("ld", 1, 1);
-			prof_inc("inc", 1, 1);
+			prof_inc(F_ADD, 1, 1);
+			prof_inc(ld, 1, 1);
+			prof_inc(inc, 1, 1);
 			w = F_ADD(*inter_ptr++, w); // Add partial
 		}
-		prof_inc("st", 1, 1);
-		prof_inc("inc", 1, 1);
+		prof_inc(st, 1, 1);
+		prof_inc(inc, 1, 1);
 		*dest_ptr++ = w;
 	}
 	prof_pulse(0x10);
@@ -1,11 +1,15 @@
 #ifndef BLAS_H
 #define BLAS_H
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #include <libalpaca/alpaca.h>
 #include <libfixed/fixed.h>
 
+#include "profile.h"
+#include "misc.h"
+
 #if CONFIG_DMA == 0 // Disable DMA
 #pragma message "Disable DMA"
 	#define DMA_ENABLE && 0
@@ -18,8 +22,43 @@
 #endif
 
 #define TASK_UID_BLAS_OFFSET 10
+#ifdef CONFIG_SHIFT
+#define SHIFT CONFIG_SHIFT
+#else
 #define SHIFT 7
-// #define SHIFT 5
+#endif
+// LEA convs shift the coefficients by what params.shift leaves of
+// 2 * SHIFT + 1, the FIR products keep their scale whatever the layer shift
+#define COEF_SHIFT (2 * SHIFT + 1 - params.shift)
+
+// Accumulator of the dense kernels, raw products are summed at full width and
+// rounded to a fixed once per output
+#if CONFIG_BITWIDTH > 16
+typedef int64_t acc_t;
+#else
+typedef int32_t acc_t;
+#endif
+#define ACC_MUL(a, b) ((acc_t)(a) * (b))
+#define ACC_MAX (((acc_t)1 << (sizeof(fixed) * 8 - 1)) - 1)
+#define ACC_MIN (-((acc_t)1 << (sizeof(fixed) * 8 - 1)))
+
+static inline fixed acc_round(acc_t acc) {
+	acc = (acc + F_K) >> F_N;
+	if(acc > ACC_MAX) {
+		prof_sat_acc();
+		return ACC_MAX;
+	}
+	if(acc < ACC_MIN) {
+		prof_sat_acc();
+		return ACC_MIN;
+	}
+	return acc;
+}
+
+// FC epilogue of task_dm_mul and task_svm_mul, output row i starts from its
+// bias and goes through the ReLU on its last write
+#define FC_BIAS(i) (params.bias == NULL ? F_LIT(0.0) : params.bias[i])
+#define FC_RELU(w) ((params.relu && F_LT((w), F_LIT(0.0))) ? F_LIT(0.0) : (w))
 
 void task_ds_zero();
 void task_ds_add();
@@ -27,6 +66,7 @@ void task_ds_mul();
 void task_ds_div();
 void task_dm_add();
 void task_dm_mul();
+void task_dmv_mul();
 void task_dm_conv();
 void task_sm_mul();
 void task_svm_mul();
@@ -38,6 +78,7 @@ extern TASK_DEC(task_ds_mul);
 extern TASK_DEC(task_ds_div);
 extern TASK_DEC(task_dm_add);
 extern TASK_DEC(task_dm_mul);
+extern TASK_DEC(task_dmv_mul);
 extern TASK_DEC(task_dm_conv);
 extern TASK_DEC(task_sm_mul);
 extern TASK_DEC(task_svm_mul);
@@ -3,6 +3,8 @@
 
 #include <libalpaca/alpaca.h>
 
+#include "trace.h"
+
 void setup_cleanup(task_t *);
 void task_cleanup();
 extern TASK_DEC(task_cleanup);
@@ -0,0 +1,33 @@
+#ifndef DELTA_H
+#define DELTA_H
+#include <stdint.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "blas.h"
+
+#define TASK_UID_DELTA_OFFSET 90
+
+// Delta inference for FC layers. A layer whose weights are registered keeps
+// the input its outputs are up to date with (x, cols long) and the outputs
+// before bias and ReLU (acc, two halves of rows, half cur is current). A run
+// only multiplies the columns of the weights whose input moved by more than
+// thresh, x follows those inputs only, so it never drifts more than thresh
+// from the real input. Zeroed x and acc start from an all zero input, the
+// first run is then a full one. With thresh 0 the outputs match a full run.
+typedef struct {
+	mat_t *mat;
+	fixed *x;
+	acc_t *acc;
+	uint16_t cur;
+	fixed thresh;
+} delta_t;
+
+void delta_register(delta_t *, uint16_t);
+delta_t *delta_find(mat_t *);
+
+void task_delta_mul();
+extern TASK_DEC(task_delta_mul);
+
+#endif
@@ -3,18 +3,51 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <libfixed/fixed.h>
 
 #ifndef CONFIG_CONSOLE
 	#define printf(fmt, ...) (void)0
 #endif
 
+// Index type for flat loops over whole tensors, CONFIG_IDX32 lifts the 65,535
+// element limit. A 32 bit index takes two scratch slots, n and n + 1.
+#ifdef CONFIG_IDX32
+typedef uint32_t idx_t;
+#define IDX_SCRATCH(n) (*(idx_t *)(CUR_SCRATCH + (n)))
+#define IDX_BAK(n) (*(idx_t *)(scratch_bak + (n)))
+#else
+typedef uint16_t idx_t;
+#define IDX_SCRATCH(n) (CUR_SCRATCH[n])
+#define IDX_BAK(n) (scratch_bak[n])
+#endif
+
+// Frames convolved together, weight stationary, by task_dm_conv/task_sm_conv
+// of the base and flex backends. The frames of a layer are stacked along its
+// rows, src is [C, batch * H, W] and dest [F, batch * H', W']. task_dm_conv
+// accumulates up to CONFIG_BATCH frames per weight load, more take passes.
+// The tile and LEA kernels take one frame and stop on a batched layer.
+#ifndef CONFIG_BATCH
+#define CONFIG_BATCH 4
+#endif
+#define BATCH_LEN (params.batch < 2 ? 1 : params.batch)
+
 typedef struct {
 	bool same_padding;
 	bool transpose;
 	uint16_t stride[3];
 	uint16_t size[3];
+	uint16_t shift; // Activation pre-shift of LEA convolutions, SHIFT at boot
+	fixed *bias; // Dense bias vector folded into dm_mul/svm_mul, or NULL
+	bool relu; // ReLU on the dm_mul/svm_mul outputs of an FC layer
+	uint16_t batch; // Frames per conv layer, 0 or 1 for one
+	uint16_t hop; // Streaming convs, columns the input moved since the last run
+	uint16_t col0; // Unchanged input columns in, first computed output after
+	fixed margin; // Logit lead that ends an inference early, 0 never does
 } param_t;
 
 extern param_t params;
 
+void pool_hop();
+void batch_single();
+
 #endif
@@ -0,0 +1,120 @@
+#ifndef MODEL_H
+#define MODEL_H
+#include <stdint.h>
+#include <libalpaca/alpaca.h>
+#include <libmat/mat.h>
+
+// Model images, as written by tools/convert.py --image. All fields are little
+// endian and every blob is aligned to MODEL_ALIGN bytes from the image start.
+//
+//	model_header_t
+//	model_layer_t[len_layers]
+//	model_tensor_t[len_tensors]
+//	weight, offset and size blobs
+
+#define MODEL_MAGIC 0x4E44 // "DN"
+#define MODEL_VERSION 1
+#define MODEL_ALIGN 4
+#define MODEL_MAX_DIMS 4
+#define MODEL_NONE 0xFFFF
+
+#define MODEL_LAYER_CONV 0
+#define MODEL_LAYER_DEPTHCONV 1
+#define MODEL_LAYER_FC 2
+
+#define MODEL_TENSOR_SPARSE 0x1
+
+#define MODEL_LAYER_SHIFTED 0x1 // shift is set
+
+#define MODEL_OK 0
+#define MODEL_BAD_MAGIC 1
+#define MODEL_BAD_VERSION 2
+#define MODEL_BAD_SIZE 3
+#define MODEL_BAD_CRC 4
+#define MODEL_TOO_MANY_TENSORS 5
+#define MODEL_BAD_TENSOR 6 // Descriptor out of the image or past MODEL_MAX_DIMS
+
+#define TASK_UID_MODEL_OFFSET 70
+
+typedef struct {
+	uint16_t magic;
+	uint16_t version;
+	uint16_t len_layers;
+	uint16_t len_tensors;
+	uint32_t size; // Bytes in the whole image
+	uint16_t crc; // CRC-16/CCITT of everything after the header
+	uint16_t flags;
+} model_header_t;
+
+typedef struct {
+	uint8_t type;
+	uint8_t flags;
+	uint16_t weights; // Tensor index
+	uint16_t bias; // Tensor index or MODEL_NONE
+	uint16_t shift; // Activation pre-shift for params.shift
+} model_layer_t;
+
+typedef struct {
+	uint16_t flags;
+	uint16_t len_dims;
+	uint16_t dims[MODEL_MAX_DIMS];
+	uint16_t len_sparse_dims;
+	uint16_t sparse_dims[MODEL_MAX_DIMS];
+	uint16_t reserved;
+	uint32_t data; // Byte offsets from the image start
+	uint32_t offsets;
+	uint32_t sizes;
+} model_tensor_t;
+
+typedef struct {
+	const uint8_t *image;
+	const model_header_t *header;
+	const model_layer_t *layers;
+	const model_tensor_t *tensors;
+	mat_t *mats;
+} model_t;
+
+#define MODEL_LEN_LAYERS(m) ((m)->header->len_layers)
+#define MODEL_LAYER(m, l) (&(m)->layers[l])
+#define MODEL_WEIGHTS(m, l) (&(m)->mats[(m)->layers[l].weights])
+#define MODEL_LAYER_SHIFT(m, l, def) \
+	((m)->layers[l].flags & MODEL_LAYER_SHIFTED ? (m)->layers[l].shift : (def))
+#define MODEL_BIAS(m, l) ((m)->layers[l].bias == MODEL_NONE ? \
+	NULL : &(m)->mats[(m)->layers[l].bias])
+
+uint16_t model_crc(uint16_t, const uint8_t *, uint32_t);
+uint16_t model_check_header(const uint8_t *, uint32_t);
+uint16_t model_check(const uint8_t *, uint32_t);
+uint16_t model_load(model_t *, const uint8_t *, uint32_t, mat_t *, uint16_t);
+
+#ifdef CONFIG_MODEL_SLOT_SIZE
+// Two model slots in FRAM. Inference only ever binds the active slot, new
+// images are written into the other one with model_stage() and made active by
+// task_model_commit, which validates the image and flips model_active through
+// the redo buffer. A power failure at any point leaves the old model intact.
+// Don't stage while an inference bound to the previous slot is in flight, the
+// next commit makes it the staging slot again.
+#define MODEL_SLOTS 2
+#define MODEL_CRC_CHUNK 0x200
+
+extern uint8_t model_slots[MODEL_SLOTS][CONFIG_MODEL_SLOT_SIZE];
+extern uint16_t model_active; // MODEL_NONE until the first commit
+extern uint16_t model_commit_status;
+
+#define MODEL_STAGING_SLOT() (model_active == 0 ? 1 : 0)
+#define MODEL_ACTIVE_IMAGE() \
+	(model_active == MODEL_NONE ? NULL : model_slots[model_active])
+
+uint16_t model_stage(uint32_t, const uint8_t *, uint16_t);
+uint16_t model_load_active(model_t *, mat_t *, uint16_t);
+
+void task_model_commit();
+extern TASK_DEC(task_model_commit);
+#endif
+
+#ifndef __MSP430__
+const uint8_t *model_map_file(const char *, uint32_t *);
+void model_unmap_file(const uint8_t *, uint32_t);
+#endif
+
+#endif
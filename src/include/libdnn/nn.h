@@ -1,16 +1,36 @@
 #ifndef NN_H
 #define NN_H
+#include <stdbool.h>
 #include <libalpaca/alpaca.h>
 #include <libfixed/fixed.h>
+#include <libmat/mat.h>
 
 #define TASK_UID_NN_OFFSET 20
 
+// Early exit. A side branch classifier is an ordinary FC layer on an
+// intermediate output, task_exit_check then takes its logits off the stack
+// and fills nn_exit: the top label and its lead over the runner up, and taken
+// if that lead is at least params.margin. The app skips the rest of the
+// network when it's taken. Only the result is written, through the redo
+// buffer, a reboot just checks again.
+typedef struct {
+	uint16_t label;
+	fixed lead;
+	bool taken;
+} nn_exit_t;
+
+extern nn_exit_t nn_exit;
+
 void task_d_conv();
 void task_d_depthconv();
 void task_s_conv();
 void task_s_depthconv();
+// Bias is folded into the matrix-vector product, set params.relu to fold in
+// the ReLU as well (it's cleared when the layer is done). Single vector layers
+// with weights in the delta table only compute the input change, see delta.h
 void task_d_fc();
 void task_s_fc();
+void task_exit_check();
 
 extern TASK_DEC(task_d_conv);
 extern TASK_DEC(task_d_depthconv);
@@ -18,5 +38,6 @@ extern TASK_DEC(task_s_conv);
 extern TASK_DEC(task_s_depthconv);
 extern TASK_DEC(task_d_fc);
 extern TASK_DEC(task_s_fc);
+extern TASK_DEC(task_exit_check);
 
 #endif
\ No newline at end of file
@@ -4,6 +4,40 @@
 #include <stdint.h>
 #include <libfixed/fixed.h>
 
+#if CONFIG_PROFILE == 1 && defined(CONFIG_PROFILE_MEM)
+// Memory traffic per region, invocs are accesses and ops are bytes (PTR
+// counts pointers handed out, walks through them are not seen)
+#define PROF_MEM_REGION(X, r) X(r##_LD) X(r##_ST) X(r##_PTR) X(r##_GBUF)
+#define PROF_MEM_COUNTERS(X) \
+	PROF_MEM_REGION(X, SRAM) PROF_MEM_REGION(X, LEARAM) \
+	PROF_MEM_REGION(X, FRAM) PROF_MEM_REGION(X, HIFRAM)
+#else
+#define PROF_MEM_COUNTERS(X)
+#endif
+
+#if CONFIG_PROFILE == 1 && defined(CONFIG_PROFILE_SAT)
+// Results that do not fit a fixed, invocs are events
+#define PROF_SAT_COUNTERS(X) \
+	X(SAT_F_ADD) X(SAT_F_MUL) X(SAT_LEA_MAC) X(SAT_SHIFT) X(SAT_ACC)
+#else
+#define PROF_SAT_COUNTERS(X)
+#endif
+
+// Counter registry, prof_inc takes the bare name, e.g. prof_inc(ld, 1, 1)
+#define PROF_COUNTERS(X) \
+	X(ld) X(st) X(add) X(mul) X(inc) X(loop_inc) X(loop_add) \
+	X(F_ADD) X(F_MUL) \
+	X(MAT_GET_1D) X(MAT_GET_2D) X(MAT_GET_3D) X(MAT_SET_2D) X(MAT_SET_3D) \
+	X(DMA) X(LEA_ADD) X(LEA_FIR) X(LEA_MAC) \
+	PROF_MEM_COUNTERS(X) PROF_SAT_COUNTERS(X)
+
+#define PROF_ENUM(n) PROF_##n,
+typedef enum {
+	PROF_COUNTERS(PROF_ENUM)
+	PROF_COUNTERS_LEN
+} prof_counter_t;
+#undef PROF_ENUM
+
 #if CONFIG_PROFILE == 1
 	typedef enum {
 		OPEN,
@@ -11,12 +45,107 @@
 		CLOSE,
 	} prof_control_t;
 
+	typedef struct {
+		uint32_t invocs;
+		uint32_t ops;
+	} prof_stat_t;
+
+	extern prof_stat_t prof_stats[PROF_COUNTERS_LEN];
+
 	void prof_pulse(uint16_t length);
 	void prof_on();
 	void prof_off();
-	void prof_inc(char *name, uint16_t invoc, uint16_t ops);
+	#define prof_inc(n, i, o) do { \
+		prof_stats[PROF_##n].invocs += (i); \
+		prof_stats[PROF_##n].ops += (o); \
+	} while(0)
 	void prof_print();
-	void prof(prof_control_t t, char *layer);
+	void prof(prof_control_t t, char *name);
+
+	// Re-execution accounting per task uid. Kernels count their loop
+	// iterations with prof_iter, the count is charged to the running task as
+	// kept work on a transition, or as redone work when prof_boot finds it
+	// pending. Kernels that keep their loop position in FRAM call
+	// prof_persist once it is written back.
+	extern uint32_t prof_pending;
+	extern uint32_t prof_persisted;
+
+	#define prof_iter(n) (prof_pending += (n))
+	#define prof_persist() (prof_persisted += prof_pending, prof_pending = 0)
+	void prof_transition(uint16_t uid);
+	void prof_cleanup(uint16_t uid);
+	void prof_boot(); // Call from the application's init function
+
+#ifdef CONFIG_PROFILE_MEM
+	#include <libalpaca/alpaca.h>
+	#include <libmat/mat.h>
+
+	#define PROF_MEM_LD 0
+	#define PROF_MEM_ST 1
+	#define PROF_MEM_PTR 2
+	#define PROF_MEM_GBUF 3
+
+	fixed *prof_mem(fixed *p, uint16_t kind);
+	void prof_mem_gbuf(uint8_t *dst, size_t len);
+
+	// The accessors go through libmat's mat_ptr so every element access can
+	// be charged to the region it lands in
+	#define PROF_MAT_ARGS(...) ((uint16_t[]){__VA_ARGS__}), \
+		(sizeof((uint16_t[]){__VA_ARGS__}) / sizeof(uint16_t))
+	#undef MAT_GET
+	#undef MAT_SET
+	#undef MAT_PTR
+	#define MAT_PTR(m, ...) \
+		prof_mem(mat_ptr(m, PROF_MAT_ARGS(__VA_ARGS__)), PROF_MEM_PTR)
+	#define MAT_GET(m, ...) \
+		(*prof_mem(mat_ptr(m, PROF_MAT_ARGS(__VA_ARGS__)), PROF_MEM_LD))
+	#define MAT_SET(m, val, ...) \
+		(*prof_mem(mat_ptr(m, PROF_MAT_ARGS(__VA_ARGS__)), PROF_MEM_ST) = (val))
+	#define write_to_gbuf(src, dst, len) \
+		(prof_mem_gbuf((dst), (len)), write_to_gbuf((src), (dst), (len)))
+#endif
+
+#ifdef CONFIG_PROFILE_SAT
+	// Charged to the counter, the open section and the running task
+	void prof_sat(prof_counter_t counter);
+
+	// libfixed's F_ADD and F_MUL, expanded here before they are replaced
+	static inline fixed prof_f_add(fixed a, fixed b) { return F_ADD(a, b); }
+	static inline fixed prof_f_mul(fixed a, fixed b) { return F_MUL(a, b); }
+
+	static inline fixed prof_sat_add(fixed a, fixed b) {
+		int32_t exact = (int32_t)a + b;
+		if((fixed)exact != exact) prof_sat(PROF_SAT_F_ADD);
+		return prof_f_add(a, b);
+	}
+
+	static inline fixed prof_sat_mul(fixed a, fixed b) {
+		int32_t exact = ((int32_t)a * b) >> F_N;
+		if((fixed)exact != exact) prof_sat(PROF_SAT_F_MUL);
+		return prof_f_mul(a, b);
+	}
+
+	#undef F_ADD
+	#undef F_MUL
+	#define F_ADD(a, b) prof_sat_add((a), (b))
+	#define F_MUL(a, b) prof_sat_mul((a), (b))
+
+	// v << s for the pre-shift, acc is a LEA MAC result (Q31 of the products)
+	#define prof_sat_shl(v, s) do { \
+		int32_t exact = (int32_t)(v) * (1L << (s)); \
+		if((fixed)exact != exact) prof_sat(PROF_SAT_SHIFT); \
+	} while(0)
+	#define prof_sat_mac(acc) do { \
+		int32_t exact = (int32_t)(acc) >> (F_N + 1); \
+		if((fixed)exact != exact) prof_sat(PROF_SAT_LEA_MAC); \
+	} while(0)
+	// A wide accumulator clamped by acc_round
+	#define prof_sat_acc() prof_sat(PROF_SAT_ACC)
+#else
+	#define prof_sat_shl(v, s) (void)0
+	#define prof_sat_mac(acc) (void)0
+	#define prof_sat_acc() (void)0
+#endif
 #elif CONFIG_PROFILE == 2
 #pragma message "pulse only"
 	void prof_pulse(uint16_t length);
@@ -25,6 +154,14 @@
 	#define prof_inc(n, i, o) (void)0
 	#define prof_print(t) (void)0
 	#define prof(t, l) (void)0
+	#define prof_iter(n) (void)0
+	#define prof_persist() (void)0
+	#define prof_transition(u) (void)0
+	#define prof_cleanup(u) (void)0
+	#define prof_boot() (void)0
+	#define prof_sat_shl(v, s) (void)0
+	#define prof_sat_mac(acc) (void)0
+	#define prof_sat_acc() (void)0
 #else
 #pragma message "no profiling"
 	#define prof_pulse(l) (void)0
@@ -33,6 +170,14 @@
 	#define prof_inc(n, i, o) (void)0
 	#define prof_print(t) (void)0
 	#define prof(t, l) (void)0
+	#define prof_iter(n) (void)0
+	#define prof_persist() (void)0
+	#define prof_transition(u) (void)0
+	#define prof_cleanup(u) (void)0
+	#define prof_boot() (void)0
+	#define prof_sat_shl(v, s) (void)0
+	#define prof_sat_mac(acc) (void)0
+	#define prof_sat_acc() (void)0
 #endif
 
 #endif
\ No newline at end of file
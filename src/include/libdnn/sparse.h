@@ -0,0 +1,100 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <libalpaca/alpaca.h>
+#include <libmat/mat.h>
+
+#include "blas.h"
+
+#define TASK_UID_SPARSE_OFFSET 100
+
+// Activation sparsity. Past a ReLU half or more of a vector is zero, the FC
+// kernels gather the positions of the nonzeros once and then only touch those
+// columns of the weights. A vector longer than CONFIG_NZ_LEN, or with fewer
+// than a quarter zeros, is left dense (NZ_DENSE).
+#ifndef CONFIG_NZ_LEN
+#define CONFIG_NZ_LEN 0x200
+#endif
+
+#define NZ_DENSE 0xFFFF
+
+extern uint16_t nz_idx[CONFIG_NZ_LEN];
+
+// Fills nz_idx with the (ascending) nonzero positions of a vector, returns how
+// many or NZ_DENSE. Only reads the vector, safe to run again after a reboot.
+uint16_t nz_build(mat_t *);
+
+// Packed activations. A [C, H, W] map past a ReLU is kept as a bitmap per row
+// plus its nonzeros, with C * H rows of ACT_WORDS(W) words:
+//   uint16_t bits[rows][words]  bit x & 15 of word x >> 4 is set if x != 0
+//   uint16_t base[rows][words]  index in vals of the first nonzero of a word
+//   fixed vals[]                the nonzeros in order
+// The mat keeps the dense dims, its data points at the packed buffer, which
+// needs ACT_HEADER bytes plus room for the nonzeros. task_relu_pack writes it,
+// task_d_conv reads it (base and flex task_dm_conv) and then drops the flag.
+// The other layers and task_pool stop on a packed src through act_dense.
+#ifndef CONFIG_ACT_PACKED
+#define CONFIG_ACT_PACKED 4
+#endif
+
+#define ACT_WORDS(w) (((w) + 15) >> 4)
+#define ACT_HEADER(c, h, w) (4 * (c) * (h) * ACT_WORDS(w))
+#define ACT_NZ(bits, x) ((bits)[(x) >> 4] & (1u << ((x) & 15)))
+
+bool act_is_packed(mat_t *);
+void act_set_packed(mat_t *, bool);
+void act_dense(mat_t *);
+
+static inline uint16_t act_count(uint16_t word) {
+	uint16_t n = 0;
+	for(; word; word &= word - 1) n++;
+	return n;
+}
+
+static inline uint16_t act_rows(mat_t *m) {
+	return MAT_GET_DIM(m, 0) * MAT_GET_DIM(m, 1);
+}
+
+static inline uint16_t *act_bits(mat_t *m, uint16_t r) {
+	return (uint16_t *)m->data + r * ACT_WORDS(MAT_GET_DIM(m, 2));
+}
+
+static inline uint16_t *act_base(mat_t *m, uint16_t r) {
+	return act_bits(m, act_rows(m) + r);
+}
+
+static inline fixed *act_vals(mat_t *m) {
+	return (fixed *)act_bits(m, 2 * act_rows(m));
+}
+
+// Dot product of len weights with row r of a packed map from column x on,
+// zero activations (and columns past the end) are skipped
+static inline acc_t act_dot(mat_t *m, uint16_t r, uint16_t x, fixed *f,
+	uint16_t len) {
+	uint16_t cols = MAT_GET_DIM(m, 2);
+	if(x >= cols) return 0;
+	uint16_t *bits = act_bits(m, r);
+	fixed *val = act_vals(m) + act_base(m, r)[x >> 4] + 
+		act_count(bits[x >> 4] & ((1u << (x & 15)) - 1));
+	acc_t w = 0;
+	for(uint16_t n = 0; n < len && x < cols; n++, x++) {
+		if(ACT_NZ(bits, x)) w += ACC_MUL(f[n], *val++);
+	}
+	return w;
+}
+
+// Columns of the activation matrix task_smm_mul carries per pass over a row
+// of weights, wider batches take several passes
+#ifndef CONFIG_SMM_COLS
+#define CONFIG_SMM_COLS 8
+#endif
+
+void task_svsv_mul();
+void task_smm_mul();
+void task_relu_pack();
+extern TASK_DEC(task_svsv_mul);
+extern TASK_DEC(task_smm_mul);
+extern TASK_DEC(task_relu_pack);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef STREAM_H
+#define STREAM_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <libalpaca/alpaca.h>
+#include <libmat/mat.h>
+
+#include "buffer.h"
+#include "misc.h"
+
+#define TASK_UID_STREAM_OFFSET 80
+#define STREAM_NONE 0xFFFF
+
+// Sparse weights kept in external storage (SPI NOR, SD card, a file on host).
+// mat holds the shape and the resident sparse.sizes, its data and offsets are
+// never read. data and offsets are storage addresses, e.g. the blob offsets of
+// a model image from tools/convert.py --image.
+typedef struct {
+	mat_t *mat;
+	uint32_t data;
+	uint32_t offsets;
+} stream_t;
+
+// Blocks are staged in the two halves of MAT_BUFFER(2), the next one is
+// prefetched while the current one is computed on. A block that doesn't fit
+// in a half is staged in the whole buffer without prefetching, a single filter
+// or row has to fit in CONFIG_MAT_BUF_SIZE (stream_register checks it).
+#define STREAM_HALF (CONFIG_MAT_BUF_SIZE / 2)
+#define STREAM_BUF(h) (MAT_BUFFER(2) + (h) * STREAM_HALF)
+
+// Storage access, the application provides stream_read for its device. The
+// default stream_prefetch just calls stream_read, override it (and
+// stream_wait) to start DMA driven reads.
+void stream_read(uint32_t, uint8_t *, uint16_t);
+void stream_prefetch(uint32_t, uint8_t *, uint16_t);
+void stream_wait(void);
+
+#ifndef __MSP430__
+bool stream_open(const char *);
+void stream_close(void);
+#endif
+
+void stream_register(stream_t *, uint16_t);
+stream_t *stream_find(mat_t *);
+void stream_filter(stream_t *, mat_t *, uint16_t, idx_t);
+
+void task_svm_mul_stream();
+extern TASK_DEC(task_svm_mul_stream);
+
+#endif
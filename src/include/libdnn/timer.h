@@ -0,0 +1,34 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// 32 bit time in ticks of CONFIG_TIMER_HZ, monotonic across reboots (time
+// spent powered off is not seen). Timer_A CONFIG_TIMER (0 by default) on the
+// device, clock_gettime on the host, or with CONFIG_TIMER_VIRTUAL a clock the
+// simulator (or the application) moves with timer_advance. Only built with
+// CONFIG_TRACE or CONFIG_PROFILE == 1, the device timer and its overflow
+// interrupt are then the library's.
+
+#ifndef CONFIG_TIMER_HZ
+#define CONFIG_TIMER_HZ 1000000UL
+#endif
+
+#if defined(CONFIG_TRACE) || CONFIG_PROFILE == 1
+	#define TIMER_ENABLED 1
+
+	uint32_t timer_now();
+	void timer_boot(); // Once per boot, trace_boot and prof_boot call it
+#ifdef CONFIG_TIMER_VIRTUAL
+	extern uint32_t timer_virtual;
+	#define timer_advance(n) (timer_virtual += (n))
+#else
+	#define timer_advance(n) (void)0
+#endif
+#else
+	#define timer_now() 0
+	#define timer_boot() (void)0
+	#define timer_advance(n) (void)0
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <libalpaca/alpaca.h>
+
+#include "profile.h"
+
+// Task level trace kept in an FRAM ring buffer, decode the output of
+// trace_print() (or a raw dump of trace_buf) with tools/trace_decode.py
+
+#define TRACE_TRANSITION 0 // uid is the task transitioned to
+#define TRACE_CLEANUP 1 // uid is the task that completed
+#define TRACE_BOOT 2 // uid is the task resumed after a reboot
+
+typedef struct {
+	uint32_t time;
+	uint16_t uid;
+	uint8_t event;
+	uint8_t epoch; // Reboot count, wraps
+} trace_t;
+
+#ifdef CONFIG_TRACE
+	extern trace_t trace_buf[CONFIG_TRACE_LENGTH];
+	extern uint16_t trace_head;
+
+	void trace(uint8_t event, uint16_t uid);
+	void trace_boot();
+	void trace_print();
+	void trace_reset();
+#else
+	#define trace(e, u) (void)0
+	#define trace_boot() (void)0
+	#define trace_print() (void)0
+	#define trace_reset() (void)0
+#endif
+
+#if defined(CONFIG_TRACE) || CONFIG_PROFILE == 1
+	// Every transition goes through here, including transitions to self. The
+	// macro is defined after, so the call below is libalpaca's.
+	static inline void trace_transition(task_t *t) {
+		trace(TRACE_TRANSITION, t->idx);
+		prof_transition(t->idx);
+		transition_to(t);
+	}
+	#define transition_to(t) trace_transition(t)
+#endif
+
+#endif
@@ -56,7 +56,7 @@ void task_dm_conv() {
 				if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
 					j + n < MAT_GET_DIM(src, 2))) {
 					w = F_MUL(MAT_GET(filter, k, l, n), 
-						(MAT_GET(src, k, i + l, j + n) >> SHIFT));
+						(MAT_GET(src, k, i + l, j + n) >> params.shift));
 				}
 				if(k == 0 && l == 0 && n == 0) { // Zero
 					MAT_SET(dest, w, i_stride, j_stride);
@@ -135,7 +135,9 @@ void task_dm_conv() {
 			tsrc1[filter_length - i - 1] = 0;
 			continue;
 		}
-		tsrc1[filter_length - i - 1] = MAT_GET(filter, k, l, n + i) << (SHIFT + 1);
+		prof_sat_shl(MAT_GET(filter, k, l, n + i), COEF_SHIFT);
+		tsrc1[filter_length - i - 1] = 
+			MAT_GET(filter, k, l, n + i) << COEF_SHIFT;
 	}
 	for(uint16_t i = CUR_SCRATCH[4]; i < rows; i = ++CUR_SCRATCH[4]) {
 		for(uint16_t j = CUR_SCRATCH[5]; j < cols; j = (CUR_SCRATCH[5] += common_tile_size)) {
@@ -0,0 +1,78 @@
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+#include <libmspdriver/driverlib.h>
+#include <libdsp/DSPLib.h>
+
+#include "lea.h"
+#include "mem.h"
+#include "blas.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "profile.h"
+#include "cleanup.h"
+
+TASK(TASK_UID_BLAS_OFFSET + 7, task_dmv_mul);
+
+// Loads len fixeds into LEA RAM
+static void load(fixed *dest, fixed *src, uint16_t len) {
+	if(len > 12 DMA_ENABLE) {
+		DMA_setTransferSize(dma_config.channelSelect, len);
+		DMA_setSrcAddress(dma_config.channelSelect, 
+			(uint32_t) src, DMA_DIRECTION_INCREMENT);
+		DMA_setDstAddress(dma_config.channelSelect, 
+			(uint32_t) dest, DMA_DIRECTION_INCREMENT);
+		DMA_enableTransfers(dma_config.channelSelect);
+		DMA_startSleepTransfer(dma_config.channelSelect);
+		prof_inc(DMA, 1, len);
+	} else {
+		memcpy(dest, src, sizeof(fixed) * len);
+		prof_inc(ld, len, len);
+	}
+}
+
+// Dense matrix vector multiplication, rows are read straight from filter and
+// dotted with src in chunks as long as the LEA buffers allow
+void task_dmv_mul() {
+	uint16_t tile_size = check_calibrate();
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	uint16_t rows = MAT_GET_DIM(filter, 0);
+	uint16_t cols = MAT_GET_DIM(filter, 1);
+	uint16_t chunk = tile_size & ~0x01;
+	msp_mac_q15_params params_mac;
+	msp_status status;
+
+	prof_pulse(0x20);
+	for(uint16_t i = CUR_SCRATCH[0]; i < rows; i = ++CUR_SCRATCH[0]) {
+		prof_inc(loop_inc, 1, 1);
+		prof_persist();
+		prof_iter(1);
+		acc_t w = (acc_t)FC_BIAS(i) * F_ONE;
+		for(uint16_t k = 0; k < cols; k += chunk) {
+			uint16_t len = (cols - k < chunk) ? cols - k : chunk;
+			load(tsrc1, MAT_PTR(filter, i, k), len);
+			load(tsrc2, src->data + k, len);
+			if(len & 0x01) { // Pad to an even length
+				tsrc1[len] = 0;
+				tsrc2[len] = 0;
+			}
+			params_mac.length = len + (len & 0x01);
+			prof_inc(LEA_MAC, 1, params_mac.length);
+			status = msp_mac_q15(&params_mac, tsrc1, tsrc2, tdest1);
+			msp_checkStatus(status);
+			w += *(int32_t *)tdest1 >> 1; // Q31 back to the raw products
+		}
+		MAT_SET(dest, FC_RELU(acc_round(w)), i, 0);
+		prof_inc(MAT_SET_2D, 1, 1);
+	}
+	prof_pulse(0x20);
+
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
\ No newline at end of file
@@ -1,4 +1,33 @@
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+
 #include "misc.h"
 #include "mem.h"
+#include "blas.h"
+#include "profile.h"
+
+__fram param_t params = {.shift = SHIFT};
+
+static __fram uint16_t pool_bak[2];
+// Output hop and unchanged columns of a pool after a streaming conv. Staged
+// and committed with the pool's last transition, so a redone pool doesn't
+// scale them twice. A hop that isn't a multiple of the stride ends streaming.
+void pool_hop() {
+	uint16_t stride = params.stride[2];
+	pool_bak[0] = 0;
+	pool_bak[1] = 0;
+	if(params.hop > 0 && params.hop % stride == 0 && 
+		params.col0 >= params.size[2]) {
+		pool_bak[0] = params.hop / stride;
+		pool_bak[1] = (params.col0 - params.size[2]) / stride + 1;
+	}
+	write_to_gbuf((uint8_t *)pool_bak, (uint8_t *)&params.hop, 
+		2 * sizeof(uint16_t));
+}
 
-__fram param_t params;
+// Stops on a batched layer, for the conv kernels that take a single frame
+void batch_single() {
+	if(params.batch < 2) return;
+	PRINTF("\r\n Batch of %u frames, this backend takes one", params.batch);
+	while(1) {}
+}
@@ -0,0 +1,224 @@
+#include "model.h"
+
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#ifndef __MSP430__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mem.h"
+#include "misc.h"
+#include "cleanup.h"
+
+// CRC-16/CCITT, start with crc = 0xFFFF
+uint16_t model_crc(uint16_t crc, const uint8_t *data, uint32_t len) {
+	for(uint32_t i = 0; i < len; i++) {
+		crc ^= (uint16_t)data[i] << 8;
+		for(uint16_t j = 0; j < 8; j++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+// Validates the header of an image of at most len bytes, pass 0 to trust the
+// header size
+uint16_t model_check_header(const uint8_t *image, uint32_t len) {
+	const model_header_t *header = (const model_header_t *)image;
+	if(header->magic != MODEL_MAGIC) return MODEL_BAD_MAGIC;
+	if(header->version != MODEL_VERSION) return MODEL_BAD_VERSION;
+	uint32_t tables = sizeof(model_header_t) +
+		(uint32_t)header->len_layers * sizeof(model_layer_t) +
+		(uint32_t)header->len_tensors * sizeof(model_tensor_t);
+	if(header->size < tables || (len != 0 && header->size > len))
+		return MODEL_BAD_SIZE;
+	return MODEL_OK;
+}
+
+uint16_t model_check(const uint8_t *image, uint32_t len) {
+	const model_header_t *header = (const model_header_t *)image;
+	uint16_t err = model_check_header(image, len);
+	if(err != MODEL_OK) return err;
+	if(model_crc(0xFFFF, image + sizeof(model_header_t),
+		header->size - sizeof(model_header_t)) != header->crc)
+		return MODEL_BAD_CRC;
+	return MODEL_OK;
+}
+
+// True if count words at offset lie inside an image of size bytes
+static bool model_fits(uint32_t offset, uint32_t count, uint32_t size) {
+	if((offset & 1) || offset > size) return false;
+	return count <= (size - offset) / sizeof(uint16_t);
+}
+
+// Checks a tensor descriptor against the image before anything is bound to
+// it: dims within MODEL_MAX_DIMS, and the values, offsets (one past the last
+// value, the kernels peek there) and sizes (a count per filter, or rows + 1
+// CSR row starts for 2-D) inside the image
+static uint16_t model_check_tensor(const model_tensor_t *t, uint32_t size) {
+	if(t->len_dims > MODEL_MAX_DIMS || t->len_dims == 0 ||
+		t->len_sparse_dims > MODEL_MAX_DIMS) return MODEL_BAD_TENSOR;
+	uint32_t len = 1;
+	for(uint16_t d = 0; d < t->len_dims; d++) {
+		len *= t->dims[d];
+		if(len > size) return MODEL_BAD_TENSOR; // Also keeps len from wrapping
+	}
+	if(!model_fits(t->data, len, size)) return MODEL_BAD_TENSOR;
+	if(!(t->flags & MODEL_TENSOR_SPARSE)) return MODEL_OK;
+	if(t->len_sparse_dims == 0) return MODEL_BAD_TENSOR;
+	uint32_t sizes = t->sparse_dims[0] + (t->len_sparse_dims == 2 ? 1 : 0);
+	if(!model_fits(t->offsets, len + 1, size) ||
+		!model_fits(t->sizes, sizes, size)) return MODEL_BAD_TENSOR;
+	return MODEL_OK;
+}
+
+// Binds the tensors of an image without copying, mats[i].data and the sparse
+// index arrays point straight into the image. The header has been checked,
+// the tables it describes lie inside header->size.
+static uint16_t model_bind(model_t *m, const uint8_t *image, mat_t *mats,
+	uint16_t len_mats) {
+	m->image = image;
+	m->header = (const model_header_t *)image;
+	m->layers = (const model_layer_t *)(m->header + 1);
+	m->tensors = (const model_tensor_t *)(m->layers + m->header->len_layers);
+	m->mats = mats;
+	uint16_t len_tensors = m->header->len_tensors;
+	if(len_tensors > len_mats) return MODEL_TOO_MANY_TENSORS;
+	for(uint16_t l = 0; l < m->header->len_layers; l++) {
+		const model_layer_t *layer = &m->layers[l];
+		if(layer->weights >= len_tensors || (layer->bias != MODEL_NONE &&
+			layer->bias >= len_tensors)) return MODEL_BAD_TENSOR;
+	}
+	for(uint16_t i = 0; i < len_tensors; i++) {
+		uint16_t err = model_check_tensor(&m->tensors[i], m->header->size);
+		if(err != MODEL_OK) {
+			PRINTF("\r\n Bad model tensor %u", i);
+			return err;
+		}
+	}
+	for(uint16_t i = 0; i < len_tensors; i++) {
+		const model_tensor_t *t = &m->tensors[i];
+		mat_t *mat = &m->mats[i];
+		memset(mat, 0, sizeof(mat_t));
+		mat_reshape(mat, (uint16_t *)t->dims, t->len_dims);
+		mat->data = (fixed *)(m->image + t->data);
+		if(t->flags & MODEL_TENSOR_SPARSE) {
+			memcpy(mat->sparse.dims, t->sparse_dims,
+				t->len_sparse_dims * sizeof(uint16_t));
+			mat->sparse.len_dims = t->len_sparse_dims;
+			mat->sparse.offsets = (uint16_t *)(m->image + t->offsets);
+			mat->sparse.sizes = (uint16_t *)(m->image + t->sizes);
+		}
+	}
+	return MODEL_OK;
+}
+
+// len is the number of bytes at image (the file or the array it was read
+// into), the header's size is not trusted past it
+uint16_t model_load(model_t *m, const uint8_t *image, uint32_t len,
+	mat_t *mats, uint16_t len_mats) {
+	if(len < sizeof(model_header_t)) return MODEL_BAD_SIZE;
+	uint16_t err = model_check(image, len);
+	if(err != MODEL_OK) {
+		PRINTF("\r\n Bad model image: %u", err);
+		return err;
+	}
+	return model_bind(m, image, mats, len_mats);
+}
+
+#ifdef CONFIG_MODEL_SLOT_SIZE
+__hifram uint8_t model_slots[MODEL_SLOTS][CONFIG_MODEL_SLOT_SIZE];
+__fram uint16_t model_active = MODEL_NONE;
+__fram uint16_t model_commit_status;
+static __fram uint16_t model_active_bak;
+
+// Writes part of a new image into the staging slot. Rewriting the same bytes
+// after a reboot is harmless since inference never reads this slot.
+uint16_t model_stage(uint32_t offset, const uint8_t *data, uint16_t len) {
+	if(offset + len > CONFIG_MODEL_SLOT_SIZE) return MODEL_BAD_SIZE;
+	memcpy(model_slots[MODEL_STAGING_SLOT()] + offset, data, len);
+	return MODEL_OK;
+}
+
+uint16_t model_load_active(model_t *m, mat_t *mats, uint16_t len_mats) {
+	if(model_active == MODEL_NONE) return MODEL_BAD_MAGIC;
+	// The image was checked when it was committed
+	return model_bind(m, model_slots[model_active], mats, len_mats);
+}
+
+// Public tasks
+TASK(TASK_UID_MODEL_OFFSET, task_model_commit);
+
+// Validates the staging slot a chunk at a time, then atomically makes it the
+// active slot. Sets model_commit_status either way.
+void task_model_commit() {
+	const uint8_t *image = model_slots[MODEL_STAGING_SLOT()];
+	const model_header_t *header = (const model_header_t *)image;
+	if(CUR_SCRATCH[0] == 0) {
+		model_commit_status = model_check_header(image, CONFIG_MODEL_SLOT_SIZE);
+		if(model_commit_status == MODEL_OK) {
+			PRINTF("\r\n Checking staged model");
+			uint32_t pos = sizeof(model_header_t);
+			scratch_bak[0] = 1;
+			scratch_bak[1] = 0xFFFF;
+			scratch_bak[2] = pos & 0xFFFF;
+			scratch_bak[3] = pos >> 16;
+			write_to_gbuf((uint8_t *)(scratch_bak),
+				(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t) * 4);
+			transition_to(CUR_TASK);
+		}
+	} else if(CUR_SCRATCH[0] == 1) {
+		uint32_t pos = CUR_SCRATCH[2] | ((uint32_t)CUR_SCRATCH[3] << 16);
+		if(pos < header->size) {
+			uint32_t len = header->size - pos;
+			if(len > MODEL_CRC_CHUNK) len = MODEL_CRC_CHUNK;
+			scratch_bak[1] = model_crc(CUR_SCRATCH[1], image + pos, len);
+			pos += len;
+			scratch_bak[2] = pos & 0xFFFF;
+			scratch_bak[3] = pos >> 16;
+			write_to_gbuf((uint8_t *)(scratch_bak + 1),
+				(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t) * 3);
+			transition_to(CUR_TASK);
+		}
+		if(CUR_SCRATCH[1] == header->crc) {
+			PRINTF("\r\n Switching to model slot %u", MODEL_STAGING_SLOT());
+			model_commit_status = MODEL_OK;
+			model_active_bak = MODEL_STAGING_SLOT();
+			write_to_gbuf((uint8_t *)(&model_active_bak),
+				(uint8_t *)(&model_active), sizeof(uint16_t));
+		} else {
+			model_commit_status = MODEL_BAD_CRC;
+		}
+	}
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
+#endif
+
+#ifndef __MSP430__
+const uint8_t *model_map_file(const char *path, uint32_t *len) {
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return NULL;
+	struct stat st;
+	if(fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+	void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(image == MAP_FAILED) return NULL;
+	*len = st.st_size;
+	return (const uint8_t *)image;
+}
+
+void model_unmap_file(const uint8_t *image, uint32_t len) {
+	munmap((void *)image, len);
+}
+#endif
@@ -14,6 +14,9 @@
 #include "misc.h"
 #include "cleanup.h"
 #include "profile.h"
+#include "stream.h"
+#include "sparse.h"
+#include "delta.h"
 
 static __fram mat_t m = {.data = LAYER_BUFFER(0)};
 static __fram mat_t *inter = &m;
@@ -23,6 +26,19 @@ static __fram mat_t *c_src_ptr = &c_src;
 static __fram mat_t *c_dest_ptr = &c_dest;
 static __fram mat_t *c_inter_ptr = &c_inter;
 
+// Filter of a sparse weight starting at running_size, MAT_CONSTRAIN only takes
+// 16 bit indices
+static mat_t constrain_filter(mat_t *w, idx_t running_size) {
+#ifdef CONFIG_IDX32
+	mat_t c = MAT_CONSTRAIN(w, 0);
+	c.data += running_size;
+	c.sparse.offsets += running_size;
+	return c;
+#else
+	return MAT_CONSTRAIN(w, running_size);
+#endif
+}
+
 // Public tasks
 TASK(TASK_UID_NN_OFFSET + 0, task_d_conv);
 TASK(TASK_UID_NN_OFFSET + 1, task_d_depthconv);
@@ -30,51 +46,59 @@ TASK(TASK_UID_NN_OFFSET + 2, task_s_conv);
 TASK(TASK_UID_NN_OFFSET + 3, task_s_depthconv);
 TASK(TASK_UID_NN_OFFSET + 4, task_d_fc);
 TASK(TASK_UID_NN_OFFSET + 5, task_s_fc);
+TASK(TASK_UID_NN_OFFSET + 6, task_exit_check);
+
+__fram nn_exit_t nn_exit;
+static __fram nn_exit_t exit_bak;
 
 #ifdef CONFIG_LEA
 #pragma message "Using LEA Backend"
+// The convolutions read a copy of src at params.shift, src itself is left as
+// it is so no tensor is ever in another format than the rest of the library
+// expects. The copy takes LAYER_BUFFER(3), free while a conv layer runs. With
+// a shift of 0 they read src itself.
+static __fram mat_t sm = {.data = LAYER_BUFFER(3)};
+static __fram mat_t *shifted = &sm;
+#define SHIFTED(src) (params.shift == 0 ? (src) : shifted)
+
+// Rescales src into shifted, then goes on to the convolutions (phase 2)
+static void shift_src(mat_t *src) {
+	if(params.shift > 2 * SHIFT + 1) {
+		PRINTF("\r\n Shift %u past 2 * SHIFT + 1", params.shift);
+		while(1) {}
+	}
+	if(params.shift != 0) {
+		PRINTF("\r\n Shifting src");
+		mat_reshape(shifted, src->dims, src->len_dims);
+		idx_t total_elements = (idx_t)MAT_GET_DIM(src, 0) * 
+			MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
+		fixed *src_ptr = src->data + IDX_SCRATCH(2);
+		fixed *shifted_ptr = shifted->data + IDX_SCRATCH(2);
+		for(idx_t k = IDX_SCRATCH(2); k < total_elements; k = ++IDX_SCRATCH(2)) {
+			prof_sat_shl(*src_ptr, params.shift);
+			*shifted_ptr++ = *src_ptr++ << params.shift;
+		}
+	}
+	scratch_bak[0] = 2;
+	IDX_BAK(2) = 0;
+	write_to_gbuf((uint8_t *)(scratch_bak), 
+		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
+	write_to_gbuf((uint8_t *)(scratch_bak + 2), 
+		(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));	
+	transition_to(CUR_TASK);	
+}
+
 void task_d_conv() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
+	batch_single();
+	act_dense(src);
 	uint16_t filters = MAT_GET_DIM(w, 0);
-	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
-		PRINTF("\r\n Shifting src");
-		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			*inter_ptr++ = *src_ptr++ << SHIFT;
-		}
-		scratch_bak[0] = 1;
-		scratch_bak[2] = 0;
-		write_to_gbuf((uint8_t *)(scratch_bak), 
-			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
-		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
-		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 1) { // Sparse Convolve
-		PRINTF("\r\n Writing back");
-		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			*src_ptr++ = *inter_ptr++;
-		}
-		scratch_bak[0] = 2;
-		scratch_bak[2] = 0;
-		write_to_gbuf((uint8_t *)(scratch_bak), 
-			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
-		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
-		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 2) {
+	if(CUR_SCRATCH[0] < 2) shift_src(src);
+	if(CUR_SCRATCH[0] == 2) {
 		uint16_t i = CUR_SCRATCH[1];
 		if(i < filters) {
 			PRINTF("\r\n    Convolving %u", i);
@@ -82,7 +106,7 @@ void task_d_conv() {
 			// Assumes filter, dest, src in that order
 			c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
 			c_filter = MAT_CONSTRAIN(w, i);
-			PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, src);
+			PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, SHIFTED(src));
 			scratch_bak[1] = i + 1;
 			write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 				(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
@@ -126,42 +150,11 @@ void task_d_depthconv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
+	batch_single();
+	act_dense(src);
 	uint16_t filters = MAT_GET_DIM(w, 0);
-	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
-		PRINTF("\r\n Shifting src");
-		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			*inter_ptr++ = *src_ptr++ << SHIFT;
-		}
-		scratch_bak[0] = 1;
-		scratch_bak[2] = 0;
-		write_to_gbuf((uint8_t *)(scratch_bak), 
-			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
-		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
-		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 1) {
-		PRINTF("\r\n Writing back");
-		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			*src_ptr++ = *inter_ptr++;
-		}
-		scratch_bak[0] = 2;
-		scratch_bak[2] = 0;
-		write_to_gbuf((uint8_t *)(scratch_bak), 
-			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
-		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
-		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 2) {
+	if(CUR_SCRATCH[0] < 2) shift_src(src);
+	if(CUR_SCRATCH[0] == 2) {
 		uint16_t i = CUR_SCRATCH[1];
 		PRINTF("\r\n    Convolving %u", i);
 		if(i < filters) {
@@ -169,7 +162,7 @@ void task_d_depthconv() {
 			// Assumes filter, dest, src in that order
 			c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
 			c_filter = MAT_CONSTRAIN(w, i);
-			c_src = MAT_CONSTRAIN(src, i);
+			c_src = MAT_CONSTRAIN(SHIFTED(src), i);
 			MAT_RESHAPE(c_src_ptr, 1, MAT_GET_DIM(src, 1), MAT_GET_DIM(src, 2));
 			PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, c_src_ptr);
 			scratch_bak[1] = i + 1;
@@ -218,73 +211,62 @@ void task_s_conv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
+	batch_single();
+	act_dense(src);
 	uint16_t filters = w->sparse.dims[0];
 	transpose = (w->sparse.dims[2] > 1 && w->sparse.dims[3] == 1);
 	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
-		PRINTF("\r\n Shifting src");
+		if(!transpose) shift_src(src);
+		PRINTF("\r\n Copying src");
 		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			if(transpose) *inter_ptr++ = *src_ptr++;
-			else *inter_ptr++ = *src_ptr++ << SHIFT;
+		idx_t total_elements = 
+			(idx_t)MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
+		fixed *src_ptr = src->data + IDX_SCRATCH(2);
+		fixed *inter_ptr = inter->data + IDX_SCRATCH(2);
+		for(idx_t k = IDX_SCRATCH(2); k < total_elements; k = ++IDX_SCRATCH(2)) {
+			*inter_ptr++ = *src_ptr++;
 		}
 		scratch_bak[0] = 1;
-		scratch_bak[2] = 0;
+		IDX_BAK(2) = 0;
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
 		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 1) { // Sparse Convolve
+	} else if(CUR_SCRATCH[0] == 1) { // Transposed 1-D filters
 		PRINTF("\r\n Writing back");
 		mat_reshape(inter, src->dims, src->len_dims);
-		if(transpose) {
-			mat_copy(src, src_bak_ptr);
-			MAT_RESHAPE(src_bak_ptr, MAT_GET_DIM(src, 0), 
-				MAT_GET_DIM(src, 2), MAT_GET_DIM(src, 1));
-			fixed *inter_ptr = MAT_PTR(
-				inter, CUR_SCRATCH[2], CUR_SCRATCH[3], CUR_SCRATCH[4]);
-			for(uint16_t k = CUR_SCRATCH[2]; 
-				k < MAT_GET_DIM(src, 0); k = ++CUR_SCRATCH[2]) {
-				for(uint16_t i = CUR_SCRATCH[3]; 
-					i < MAT_GET_DIM(src, 1); i = ++CUR_SCRATCH[3]) {
-					for(uint16_t j = CUR_SCRATCH[4]; 
-						j < MAT_GET_DIM(src, 2); j = ++CUR_SCRATCH[4]) {
-						MAT_SET(src_bak_ptr, *inter_ptr, k, j, i);
-						inter_ptr++;
-					}
-					CUR_SCRATCH[4] = 0;
+		mat_copy(src, src_bak_ptr);
+		MAT_RESHAPE(src_bak_ptr, MAT_GET_DIM(src, 0), 
+			MAT_GET_DIM(src, 2), MAT_GET_DIM(src, 1));
+		fixed *inter_ptr = MAT_PTR(
+			inter, CUR_SCRATCH[2], CUR_SCRATCH[3], CUR_SCRATCH[4]);
+		for(uint16_t k = CUR_SCRATCH[2]; 
+			k < MAT_GET_DIM(src, 0); k = ++CUR_SCRATCH[2]) {
+			for(uint16_t i = CUR_SCRATCH[3]; 
+				i < MAT_GET_DIM(src, 1); i = ++CUR_SCRATCH[3]) {
+				for(uint16_t j = CUR_SCRATCH[4]; 
+					j < MAT_GET_DIM(src, 2); j = ++CUR_SCRATCH[4]) {
+					MAT_SET(src_bak_ptr, *inter_ptr, k, j, i);
+					inter_ptr++;
 				}
-				CUR_SCRATCH[3] = 0;
-			}
-		} else {
-			uint16_t total_elements = 
-				MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-			fixed *src_ptr = src->data + CUR_SCRATCH[2];
-			fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-			for(uint16_t k = CUR_SCRATCH[2]; 
-				k < total_elements; k = ++CUR_SCRATCH[2]) {
-				*src_ptr++ = *inter_ptr++;
+				CUR_SCRATCH[4] = 0;
 			}
+			CUR_SCRATCH[3] = 0;
 		}
 		scratch_bak[0] = 2;
-		scratch_bak[2] = 0;
-		if(transpose) {
-			PRINTF("\r\n Taking transpose");
-			write_to_gbuf((uint8_t *)(src_bak_ptr), 
-				(uint8_t *)(src), sizeof(mat_t));
-		}
+		IDX_BAK(2) = 0;
+		PRINTF("\r\n Taking transpose");
+		write_to_gbuf((uint8_t *)(src_bak_ptr), 
+			(uint8_t *)(src), sizeof(mat_t));
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
 		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));	
 		transition_to(CUR_TASK);	
 	} else if(CUR_SCRATCH[0] == 2) {
 		uint16_t i = CUR_SCRATCH[1];
-		uint16_t running_size = CUR_SCRATCH[2];
+		idx_t running_size = IDX_SCRATCH(2);
 		params.transpose = transpose;
 		if(i < filters) {
 			if(w->sparse.sizes[i] > 0) {
@@ -292,17 +274,21 @@ void task_s_conv() {
 					i, running_size, w->sparse.sizes[i]);
 				TASK_REF(task_sm_conv)->info.return_task = CUR_TASK;
 				// Assumes filter, dest, src in that order
-				c_filter = MAT_CONSTRAIN(w, running_size);
+				c_filter = constrain_filter(w, running_size);
 				c_filter.dims[0] = w->sparse.sizes[i];
 				c_filter.sparse.len_dims = w->sparse.len_dims - 1;
+				stream_t *st = stream_find(w);
+				if(st != NULL) stream_filter(st, c_filter_ptr, i, running_size);
 				c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
-				PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, src);
+				// Transposed filters read the transposed, unshifted src
+				PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, 
+					transpose ? src : SHIFTED(src));
 				scratch_bak[1] = i + 1;
-				scratch_bak[2] = running_size + w->sparse.sizes[i];
+				IDX_BAK(2) = running_size + w->sparse.sizes[i];
 				write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 					(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 				write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-					(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+					(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 				TRANSITION_TO(task_sm_conv);
 			}
 			PRINTF("\r\n     Zeroing %u", i);
@@ -357,74 +343,63 @@ void task_s_depthconv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
+	batch_single();
+	act_dense(src);
 	uint16_t filters = w->sparse.dims[0];
 	transpose = (w->sparse.dims[2] > 1 && w->sparse.dims[3] == 1);
 	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
-		PRINTF("\r\n Shifting src %u %u %u", filters, w->sparse.dims[1], w->sparse.dims[2]);
+		if(!transpose) shift_src(src);
+		PRINTF("\r\n Copying src");
 		mat_reshape(inter, src->dims, src->len_dims);
-		uint16_t total_elements = 
-			MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-		fixed *src_ptr = src->data + CUR_SCRATCH[2];
-		fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-		for(uint16_t k = CUR_SCRATCH[2]; k < total_elements; k = ++CUR_SCRATCH[2]) {
-			if(transpose) *inter_ptr++ = *src_ptr++;
-			else *inter_ptr++ = *src_ptr++ << SHIFT;
+		idx_t total_elements = 
+			(idx_t)MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
+		fixed *src_ptr = src->data + IDX_SCRATCH(2);
+		fixed *inter_ptr = inter->data + IDX_SCRATCH(2);
+		for(idx_t k = IDX_SCRATCH(2); k < total_elements; k = ++IDX_SCRATCH(2)) {
+			*inter_ptr++ = *src_ptr++;
 		}
 		scratch_bak[0] = 1;
-		scratch_bak[2] = 0;
+		IDX_BAK(2) = 0;
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
 		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 		transition_to(CUR_TASK);	
-	} else if(CUR_SCRATCH[0] == 1) { // Sparse Convolve
+	} else if(CUR_SCRATCH[0] == 1) { // Transposed 1-D filters
 		PRINTF("\r\n Writing back");
 		mat_reshape(inter, src->dims, src->len_dims);
-		if(transpose) {
-			mat_copy(src, src_bak_ptr);
-			MAT_RESHAPE(src_bak_ptr, MAT_GET_DIM(src, 0), 
-				MAT_GET_DIM(src, 2), MAT_GET_DIM(src, 1));
-			fixed *inter_ptr = MAT_PTR(
-				inter, CUR_SCRATCH[2], CUR_SCRATCH[3], CUR_SCRATCH[4]);
-			
-			for(uint16_t k = CUR_SCRATCH[2]; 
-				k < MAT_GET_DIM(src, 0); k = ++CUR_SCRATCH[2]) {
-				for(uint16_t i = CUR_SCRATCH[3]; 
-					i < MAT_GET_DIM(src, 1); i = ++CUR_SCRATCH[3]) {
-					for(uint16_t j = CUR_SCRATCH[4]; 
-						j < MAT_GET_DIM(src, 2); j = ++CUR_SCRATCH[4]) {
-						MAT_SET(src_bak_ptr, *inter_ptr, k, j, i);
-						inter_ptr++;
-					}
-					CUR_SCRATCH[4] = 0;
+		mat_copy(src, src_bak_ptr);
+		MAT_RESHAPE(src_bak_ptr, MAT_GET_DIM(src, 0), 
+			MAT_GET_DIM(src, 2), MAT_GET_DIM(src, 1));
+		fixed *inter_ptr = MAT_PTR(
+			inter, CUR_SCRATCH[2], CUR_SCRATCH[3], CUR_SCRATCH[4]);
+		
+		for(uint16_t k = CUR_SCRATCH[2]; 
+			k < MAT_GET_DIM(src, 0); k = ++CUR_SCRATCH[2]) {
+			for(uint16_t i = CUR_SCRATCH[3]; 
+				i < MAT_GET_DIM(src, 1); i = ++CUR_SCRATCH[3]) {
+				for(uint16_t j = CUR_SCRATCH[4]; 
+					j < MAT_GET_DIM(src, 2); j = ++CUR_SCRATCH[4]) {
+					MAT_SET(src_bak_ptr, *inter_ptr, k, j, i);
+					inter_ptr++;
 				}
-				CUR_SCRATCH[3] = 0;
-			}
-		} else {
-			uint16_t total_elements = 
-				MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1) * MAT_GET_DIM(src, 2);
-			fixed *src_ptr = src->data + CUR_SCRATCH[2];
-			fixed *inter_ptr = inter->data + CUR_SCRATCH[2];
-			for(uint16_t k = CUR_SCRATCH[2]; 
-				k < total_elements; k = ++CUR_SCRATCH[2]) {
-				*src_ptr++ = *inter_ptr++;
+				CUR_SCRATCH[4] = 0;
 			}
+			CUR_SCRATCH[3] = 0;
 		}
 		scratch_bak[0] = 2;
-		scratch_bak[2] = 0;
-		if(transpose) {
-			PRINTF("\r\n Taking transpose");
-			write_to_gbuf((uint8_t *)(src_bak_ptr), 
-				(uint8_t *)(src), sizeof(mat_t));
-		}
+		IDX_BAK(2) = 0;
+		PRINTF("\r\n Taking transpose");
+		write_to_gbuf((uint8_t *)(src_bak_ptr), 
+			(uint8_t *)(src), sizeof(mat_t));
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));	
 		write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));	
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));	
 		transition_to(CUR_TASK);	
 	} else if(CUR_SCRATCH[0] == 2) {
 		uint16_t i = CUR_SCRATCH[1];
-		uint16_t running_size = CUR_SCRATCH[2];
+		idx_t running_size = IDX_SCRATCH(2);
 		params.transpose = transpose;
 		if(i < filters) {
 			if(w->sparse.sizes[i] > 0) {
@@ -432,19 +407,22 @@ void task_s_depthconv() {
 					i, running_size, w->sparse.sizes[i]);
 				TASK_REF(task_sm_conv)->info.return_task = CUR_TASK;
 				// Assumes filter, dest, src in that order
-				c_filter = MAT_CONSTRAIN(w, running_size);
+				c_filter = constrain_filter(w, running_size);
 				c_filter.dims[0] = w->sparse.sizes[i];
 				c_filter.sparse.len_dims = w->sparse.len_dims - 1;
+				stream_t *st = stream_find(w);
+				if(st != NULL) stream_filter(st, c_filter_ptr, i, running_size);
 				c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
-				c_src = MAT_CONSTRAIN(src, i);
+				c_src = transpose ? 
+					MAT_CONSTRAIN(src, i) : MAT_CONSTRAIN(SHIFTED(src), i);
 				MAT_RESHAPE(c_src_ptr, 1, MAT_GET_DIM(src, 1), MAT_GET_DIM(src, 2));
 				PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, c_src_ptr);
 				scratch_bak[1] = i + 1;
-				scratch_bak[2] = running_size + w->sparse.sizes[i];
+				IDX_BAK(2) = running_size + w->sparse.sizes[i];
 				write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 					(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 				write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-					(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+					(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 				TRANSITION_TO(task_sm_conv);
 			}
 			PRINTF("\r\n     Zeroing %u", i);
@@ -492,6 +470,79 @@ void task_s_depthconv() {
 	TRANSITION_TO(task_cleanup);
 }
 #else
+// Streaming convolution. The input window moved params.hop columns left since
+// the last run and only its first params.col0 columns are unchanged (0 means
+// all but the last hop). The outputs that only see those are still good one
+// output hop to the left. They're moved there through inter (a phase for each
+// copy, scratch 8 to 11) and the kernels only compute from params.col0 on.
+// A hop that isn't a multiple of the stride moves no output whole, the run
+// computes everything.
+static void stream_cols(mat_t *src, mat_t *dest, uint16_t fcols) {
+	if(CUR_SCRATCH[8] == 0) {
+		if(params.hop == 0) {
+			params.col0 = 0;
+			return;
+		}
+		scratch_bak[8] = 1;
+		scratch_bak[9] = params.hop;
+		scratch_bak[10] = 0;
+		scratch_bak[11] = (params.col0 > 0) ?
+			params.col0 : MAT_GET_DIM(src, 2) - params.hop;
+		write_to_gbuf((uint8_t *)(scratch_bak + 8),
+			(uint8_t *)(CUR_SCRATCH + 8), 4 * sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	params.col0 = 0;
+	uint16_t stride = params.stride[2];
+	uint16_t shift = CUR_SCRATCH[9] / stride;
+	uint16_t cols = MAT_GET_DIM(dest, 2);
+	// First output whose window reaches a changed column, with same padding
+	// this also recomputes the old outputs that saw the right padding
+	int16_t first = CUR_SCRATCH[11] - fcols + stride;
+	first = (first > 0) ? first / stride : 0;
+	if(CUR_SCRATCH[9] % stride != 0 || shift >= cols || first == 0) return;
+	if(first > cols - shift) first = cols - shift;
+	params.col0 = first;
+	if(CUR_SCRATCH[8] < 3) {
+		PRINTF("\r\n Keeping %u columns", first);
+		uint16_t rows = MAT_GET_DIM(dest, 0) * MAT_GET_DIM(dest, 1);
+		for(uint16_t r = CUR_SCRATCH[10]; r < rows; r = ++CUR_SCRATCH[10]) {
+			fixed *dest_ptr = dest->data + (idx_t)r * cols;
+			fixed *inter_ptr = inter->data + (idx_t)r * first;
+			for(uint16_t j = 0; j < first; j++) {
+				if(CUR_SCRATCH[8] == 1) inter_ptr[j] = dest_ptr[j + shift];
+				else dest_ptr[j] = inter_ptr[j];
+			}
+		}
+		scratch_bak[8] = CUR_SCRATCH[8] + 1;
+		scratch_bak[10] = 0;
+		write_to_gbuf((uint8_t *)(scratch_bak + 8), 
+			(uint8_t *)(CUR_SCRATCH + 8), sizeof(uint16_t));
+		write_to_gbuf((uint8_t *)(scratch_bak + 10), 
+			(uint8_t *)(CUR_SCRATCH + 10), sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+}
+
+// Bias of the columns a streaming run computed, the rest of inter is stale
+static void stream_bias(mat_t *dest, mat_t *b) {
+	for(uint16_t i = CUR_SCRATCH[1]; 
+		i < MAT_GET_DIM(dest, 0); i = ++CUR_SCRATCH[1]) {
+		fixed bias = MAT_GET(b, i);
+		for(uint16_t r = 0; r < MAT_GET_DIM(dest, 1); r++) {
+			for(uint16_t j = params.col0; j < MAT_GET_DIM(dest, 2); j++) {
+				MAT_SET(dest, F_ADD(MAT_GET(inter, i, r, j), bias), i, r, j);
+			}
+		}
+	}
+}
+
+// Hands the output hop and the unchanged output columns to the next layer,
+// task_pool scales both for a pool in between
+static void stream_done() {
+	params.hop = (params.col0 > 0) ? CUR_SCRATCH[9] / params.stride[2] : 0;
+}
+
 void task_d_conv() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
@@ -499,6 +550,7 @@ void task_d_conv() {
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
 	uint16_t filters = MAT_GET_DIM(w, 0);
+	stream_cols(src, dest, MAT_GET_DIM(w, 3));
 	if(CUR_SCRATCH[0] == 0) { // Do convolution on all filters
 		uint16_t i = CUR_SCRATCH[1];
 		if(i < filters) {
@@ -522,10 +574,13 @@ void task_d_conv() {
 		transition_to(CUR_TASK);
 	}
 	if(b == NULL) {
+		act_set_packed(src, false); // Read once, by this layer
+		stream_done();
 		POP_STACK(mat_stack, 4);
 		setup_cleanup(CUR_TASK);
 		TRANSITION_TO(task_cleanup);
 	}
+	if(params.col0 > 0) stream_bias(dest, b);
 	uint16_t i = CUR_SCRATCH[1];
 	PRINTF("\r\n    Biasing %u", i);
 	if(i < filters) {
@@ -540,6 +595,8 @@ void task_d_conv() {
 			(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 		TRANSITION_TO(task_ds_add);
 	}
+	act_set_packed(src, false);
+	stream_done();
 	POP_STACK(mat_stack, 4);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -551,7 +608,9 @@ void task_d_depthconv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
+	act_dense(src); // Only task_d_conv reads packed maps
 	uint16_t filters = MAT_GET_DIM(w, 0);
+	stream_cols(src, dest, MAT_GET_DIM(w, 3));
 	if(CUR_SCRATCH[0] == 0) { // Do convolution on all filters
 		uint16_t i = CUR_SCRATCH[1];
 		PRINTF("\r\n    Convolving %u", i);
@@ -577,10 +636,12 @@ void task_d_depthconv() {
 		transition_to(CUR_TASK);
 	}
 	if(b == NULL) {
+		stream_done();
 		POP_STACK(mat_stack, 4);
 		setup_cleanup(CUR_TASK);
 		TRANSITION_TO(task_cleanup);
 	}
+	if(params.col0 > 0) stream_bias(dest, b);
 	uint16_t i = CUR_SCRATCH[1];
 	PRINTF("\r\n    Biasing %u", i);
 	if(i < filters) {
@@ -595,6 +656,7 @@ void task_d_depthconv() {
 			(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 		TRANSITION_TO(task_ds_add);
 	}
+	stream_done();
 	POP_STACK(mat_stack, 4);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -606,50 +668,54 @@ void task_s_conv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
-	prof_inc("st", 3, 3);
-	prof_inc("ld", 3, 3);
-	prof_inc("mul", 2, 2);	
+	act_dense(src); // Only task_d_conv reads packed maps
+	prof_inc(st, 3, 3);
+	prof_inc(ld, 3, 3);
+	prof_inc(mul, 2, 2);	
 	uint16_t filters = w->sparse.dims[0];
-	prof_inc("ld", 1, 1);
+	prof_inc(ld, 1, 1);
+	stream_cols(src, dest, w->sparse.dims[3]);
 	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
 		uint16_t i = CUR_SCRATCH[1];
-		prof_inc("ld", 1, 1);
-		uint16_t running_size = CUR_SCRATCH[2];
-		prof_inc("ld", 1, 1);
+		prof_inc(ld, 1, 1);
+		idx_t running_size = IDX_SCRATCH(2);
+		prof_inc(ld, 1, 1);
 		if(i < filters) {
 			if(w->sparse.sizes[i] > 0) {
 				PRINTF("\r\n     Convolving %u %u %u",
 					i, running_size, w->sparse.sizes[i]);
 				TASK_REF(task_sm_conv)->info.return_task = CUR_TASK;
 				// Assumes filter, dest, src in that order
-				c_filter = MAT_CONSTRAIN(w, running_size);
-				prof_inc("st", 5, 5);
-				prof_inc("ld", 5, 5);
-				prof_inc("st", 8, 8);
-				prof_inc("ld", 6, 6);
-				prof_inc("add", 6, 6);
-				prof_inc("mul", 1, 1);
+				c_filter = constrain_filter(w, running_size);
+				prof_inc(st, 5, 5);
+				prof_inc(ld, 5, 5);
+				prof_inc(st, 8, 8);
+				prof_inc(ld, 6, 6);
+				prof_inc(add, 6, 6);
+				prof_inc(mul, 1, 1);
 				c_filter.dims[0] = w->sparse.sizes[i];
 				c_filter.sparse.len_dims = w->sparse.len_dims - 1;
-				prof_inc("ld", 2, 2);
-				prof_inc("st", 2, 2);
+				stream_t *st = stream_find(w);
+				if(st != NULL) stream_filter(st, c_filter_ptr, i, running_size);
+				prof_inc(ld, 2, 2);
+				prof_inc(st, 2, 2);
 				c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
-				prof_inc("st", 5, 5);
-				prof_inc("ld", 5, 5);
-				prof_inc("st", 8, 8);
-				prof_inc("ld", 6, 6);
-				prof_inc("add", 6, 6);
-				prof_inc("mul", 1, 1);
+				prof_inc(st, 5, 5);
+				prof_inc(ld, 5, 5);
+				prof_inc(st, 8, 8);
+				prof_inc(ld, 6, 6);
+				prof_inc(add, 6, 6);
+				prof_inc(mul, 1, 1);
 				PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, src);
-				prof_inc("inc", 1, 1);
-				prof_inc("add", 1, 1);
-				prof_inc("ld", 1, 1);
+				prof_inc(inc, 1, 1);
+				prof_inc(add, 1, 1);
+				prof_inc(ld, 1, 1);
 				scratch_bak[1] = i + 1;
-				scratch_bak[2] = running_size + w->sparse.sizes[i];
+				IDX_BAK(2) = running_size + w->sparse.sizes[i];
 				write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 					(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 				write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-					(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+					(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 				TRANSITION_TO(task_sm_conv);
 			}
 			PRINTF("\r\n     Zeroing %u", i);
@@ -672,10 +738,12 @@ void task_s_conv() {
 		transition_to(CUR_TASK);
 	}
 	if(b == NULL) {
+		stream_done();
 		POP_STACK(mat_stack, 4);
 		setup_cleanup(CUR_TASK);
 		TRANSITION_TO(task_cleanup);
 	}
+	if(params.col0 > 0) stream_bias(dest, b);
 	uint16_t i = CUR_SCRATCH[1];
 	PRINTF("\r\n    Biasing %u", i);
 	if(i < filters) {
@@ -690,6 +758,7 @@ void task_s_conv() {
 			(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 		TRANSITION_TO(task_ds_add);
 	}
+	stream_done();
 	POP_STACK(mat_stack, 4);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -701,61 +770,65 @@ void task_s_depthconv() {
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
 	mat_reshape(inter, dest->dims, dest->len_dims);
-	prof_inc("st", 3, 3);
-	prof_inc("ld", 3, 3);
-	prof_inc("mul", 2, 2);	
+	act_dense(src); // Only task_d_conv reads packed maps
+	prof_inc(st, 3, 3);
+	prof_inc(ld, 3, 3);
+	prof_inc(mul, 2, 2);	
 	uint16_t filters = w->sparse.dims[0];
-	prof_inc("ld", 1, 1);
+	prof_inc(ld, 1, 1);
+	stream_cols(src, dest, w->sparse.dims[3]);
 	if(CUR_SCRATCH[0] == 0) { // Sparse Convolve
 		uint16_t i = CUR_SCRATCH[1];
-		prof_inc("ld", 1, 1);
-		uint16_t running_size = CUR_SCRATCH[2];
-		prof_inc("ld", 1, 1);
+		prof_inc(ld, 1, 1);
+		idx_t running_size = IDX_SCRATCH(2);
+		prof_inc(ld, 1, 1);
 		if(i < filters) {
 			if(w->sparse.sizes[i] > 0) {
 				PRINTF("\r\n     Convolving %u %u %u",
 					i, running_size, w->sparse.sizes[i]);
 				TASK_REF(task_sm_conv)->info.return_task = CUR_TASK;
 				// Assumes filter, dest, src in that order
-				c_filter = MAT_CONSTRAIN(w, running_size);
-				prof_inc("st", 5, 5);
-				prof_inc("ld", 5, 5);
-				prof_inc("st", 8, 8);
-				prof_inc("ld", 6, 6);
-				prof_inc("add", 6, 6);
-				prof_inc("mul", 1, 1);
+				c_filter = constrain_filter(w, running_size);
+				prof_inc(st, 5, 5);
+				prof_inc(ld, 5, 5);
+				prof_inc(st, 8, 8);
+				prof_inc(ld, 6, 6);
+				prof_inc(add, 6, 6);
+				prof_inc(mul, 1, 1);
 				c_filter.dims[0] = w->sparse.sizes[i];
 				c_filter.sparse.len_dims = w->sparse.len_dims - 1;
-				prof_inc("ld", 2, 2);
-				prof_inc("st", 2, 2);
+				stream_t *st = stream_find(w);
+				if(st != NULL) stream_filter(st, c_filter_ptr, i, running_size);
+				prof_inc(ld, 2, 2);
+				prof_inc(st, 2, 2);
 				c_inter = (b == NULL) ? MAT_CONSTRAIN(dest, i) :  MAT_CONSTRAIN(inter, i);
-				prof_inc("st", 5, 5);
-				prof_inc("ld", 5, 5);
-				prof_inc("st", 8, 8);
-				prof_inc("ld", 6, 6);
-				prof_inc("add", 6, 6);
-				prof_inc("mul", 1, 1);
+				prof_inc(st, 5, 5);
+				prof_inc(ld, 5, 5);
+				prof_inc(st, 8, 8);
+				prof_inc(ld, 6, 6);
+				prof_inc(add, 6, 6);
+				prof_inc(mul, 1, 1);
 				c_src = MAT_CONSTRAIN(src, i);
-				prof_inc("st", 5, 5);
-				prof_inc("ld", 5, 5);
-				prof_inc("st", 8, 8);
-				prof_inc("ld", 6, 6);
-				prof_inc("add", 6, 6);
-				prof_inc("mul", 1, 1);
+				prof_inc(st, 5, 5);
+				prof_inc(ld, 5, 5);
+				prof_inc(st, 8, 8);
+				prof_inc(ld, 6, 6);
+				prof_inc(add, 6, 6);
+				prof_inc(mul, 1, 1);
 				MAT_RESHAPE(c_src_ptr, 1, MAT_GET_DIM(src, 1), MAT_GET_DIM(src, 2));
-				prof_inc("st", 3, 3);
-				prof_inc("ld", 3, 3);
-				prof_inc("mul", 2, 2);	
+				prof_inc(st, 3, 3);
+				prof_inc(ld, 3, 3);
+				prof_inc(mul, 2, 2);	
 				PUSH_STACK(mat_stack, c_filter_ptr, c_inter_ptr, c_src_ptr);
-				prof_inc("inc", 1, 1);
-				prof_inc("add", 1, 1);
-				prof_inc("ld", 1, 1);
+				prof_inc(inc, 1, 1);
+				prof_inc(add, 1, 1);
+				prof_inc(ld, 1, 1);
 				scratch_bak[1] = i + 1;
-				scratch_bak[2] = running_size + w->sparse.sizes[i];
+				IDX_BAK(2) = running_size + w->sparse.sizes[i];
 				write_to_gbuf((uint8_t *)(scratch_bak + 1), 
 					(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 				write_to_gbuf((uint8_t *)(scratch_bak + 2), 
-					(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+					(uint8_t *)(CUR_SCRATCH + 2), sizeof(idx_t));
 				TRANSITION_TO(task_sm_conv);
 			}
 			PRINTF("\r\n     Zeroing %u", i);
@@ -778,10 +851,12 @@ void task_s_depthconv() {
 		transition_to(CUR_TASK);
 	}
 	if(b == NULL) {
+		stream_done();
 		POP_STACK(mat_stack, 4);
 		setup_cleanup(CUR_TASK);
 		TRANSITION_TO(task_cleanup);
 	}
+	if(params.col0 > 0) stream_bias(dest, b);
 	uint16_t i = CUR_SCRATCH[1];
 	PRINTF("\r\n    Biasing %u", i);
 	if(i < filters) {
@@ -796,6 +871,7 @@ void task_s_depthconv() {
 			(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 		TRANSITION_TO(task_ds_add);
 	}
+	stream_done();
 	POP_STACK(mat_stack, 4);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -807,31 +883,24 @@ void task_d_fc() {
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
-	mat_reshape(inter, dest->dims, dest->len_dims);
-	if(CUR_SCRATCH[0] == 0) { // Dense mat mul
+	act_dense(src);
+	if(CUR_SCRATCH[0] == 0) { // Dense mat mul, bias and params.relu fused
 		PRINTF("\r\n     Dense MM");
-		TASK_REF(task_dm_mul)->info.return_task = CUR_TASK;
+		params.bias = (b == NULL) ? NULL : b->data;
+		// A single input vector doesn't need the general kernel
+		bool vector = dest->len_dims < 2 || MAT_GET_DIM(dest, 1) == 1;
+		task_t *mul = vector ? TASK_REF(task_dmv_mul) : TASK_REF(task_dm_mul);
+		if(vector && delta_find(w) != NULL) mul = TASK_REF(task_delta_mul);
+		mul->info.return_task = CUR_TASK;
 		// Assumes filter, dest, src in that order
-		PUSH_STACK(mat_stack, w, (b == NULL) ? dest :  inter, src);
+		PUSH_STACK(mat_stack, w, dest, src);
 		scratch_bak[0] = 1;
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
-		TRANSITION_TO(task_dm_mul);
-	} else if(CUR_SCRATCH[0] == 1) { // Bias
-		if(b == NULL) {
-			POP_STACK(mat_stack, 4);
-			setup_cleanup(CUR_TASK);
-			TRANSITION_TO(task_cleanup);
-		}
-		PRINTF("\r\n     Biasing");
-		TASK_REF(task_dm_add)->info.return_task = CUR_TASK;
-		// Assumes filter, dest, src in that order
-		PUSH_STACK(mat_stack, b, dest, inter);
-		scratch_bak[0] = 2;
-		write_to_gbuf((uint8_t *)(scratch_bak), 
-			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
-		TRANSITION_TO(task_dm_add);
+		transition_to(mul);
 	}
+	params.bias = NULL;
+	params.relu = false;
 	POP_STACK(mat_stack, 4);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -842,32 +911,74 @@ void task_s_fc() {
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *w= PEEK_STACK(mat_stack, 2);
 	mat_t *b = PEEK_STACK(mat_stack, 3);
-	mat_reshape(inter, dest->dims, dest->len_dims);
-	if(CUR_SCRATCH[0] == 0) { // Sparse mat mul
+	act_dense(src);
+	if(CUR_SCRATCH[0] == 0) { // Sparse mat mul, bias and params.relu fused
 		PRINTF("\r\n     Sparse MM");
-		TASK_REF(task_svm_mul)->info.return_task = CUR_TASK;
+		params.bias = (b == NULL) ? NULL : b->data;
+#ifdef CONFIG_TILE
+		task_t *mul = TASK_REF(task_svm_mul); // Commits a tile at a time
+#else
+		task_t *mul = TASK_REF(task_svsv_mul);
+#endif
+		bool batched = src->len_dims > 1 && MAT_GET_DIM(src, 1) > 1;
+		if(batched && stream_find(w) != NULL) {
+			// The streamed kernel takes one sample, task_smm_mul needs the
+			// weights resident
+			PRINTF("\r\n Batched input with streamed weights");
+			while(1) {}
+		}
+		if(stream_find(w) != NULL) {
+			mul = TASK_REF(task_svm_mul_stream);
+		} else if(batched) {
+			mul = TASK_REF(task_smm_mul); // A batch of samples, one per column
+		} else if(delta_find(w) != NULL) {
+			mul = TASK_REF(task_delta_mul);
+		}
+		mul->info.return_task = CUR_TASK;
 		// Assumes filter, dest, src in that order
-		PUSH_STACK(mat_stack, w, (b == NULL) ? dest :  inter, src);
+		PUSH_STACK(mat_stack, w, dest, src);
 		scratch_bak[0] = 1;
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
-		TRANSITION_TO(task_svm_mul);
-	} else if(CUR_SCRATCH[0] == 1) { // Bias
-		if(b == NULL) {
-			POP_STACK(mat_stack, 4);
-			setup_cleanup(CUR_TASK);
-			TRANSITION_TO(task_cleanup);
+		transition_to(mul);
+	}
+	params.bias = NULL;
+	params.relu = false;
+	POP_STACK(mat_stack, 4);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
+
+void task_exit_check() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	if(CUR_SCRATCH[0] == 0) {
+		uint16_t len = MAT_GET_DIM(src, 0);
+		uint16_t label = 0;
+		acc_t top = src->data[0]; // Wide, the lead can overflow a fixed
+		acc_t next = ACC_MIN;
+		for(uint16_t i = 1; i < len; i++) {
+			acc_t v = src->data[i];
+			if(v > top) {
+				next = top;
+				top = v;
+				label = i;
+			} else if(v > next) {
+				next = v;
+			}
 		}
-		PRINTF("\r\n     Biasing");
-		TASK_REF(task_dm_add)->info.return_task = CUR_TASK;
-		// Assumes filter, dest, src in that order
-		PUSH_STACK(mat_stack, b, dest, inter);
-		scratch_bak[0] = 2;
+		acc_t lead = top - next;
+		exit_bak.label = label;
+		exit_bak.lead = (lead > ACC_MAX) ? ACC_MAX : lead;
+		exit_bak.taken = len > 1 && params.margin > 0 && lead >= params.margin;
+		PRINTF("\r\n     Label %u lead %i", label, exit_bak.lead);
+		scratch_bak[0] = 1;
+		write_to_gbuf((uint8_t *)(&exit_bak), 
+			(uint8_t *)(&nn_exit), sizeof(nn_exit_t));
 		write_to_gbuf((uint8_t *)(scratch_bak), 
 			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
-		TRANSITION_TO(task_dm_add);
+		transition_to(CUR_TASK);
 	}
-	POP_STACK(mat_stack, 4);
+	POP_STACK(mat_stack, 1);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
-}
\ No newline at end of file
+}
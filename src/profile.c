@@ -2,12 +2,15 @@
 
 #include <msp430.h>
 #include <string.h>
+#include <stdbool.h>
 #include <libmspbuiltins/builtins.h>
 #include <libio/console.h>
 #include <libfixed/fixed.h>
+#include <libalpaca/alpaca.h>
 
 #include "mem.h"
 #include "misc.h"
+#include "timer.h"
 
 #ifdef CONFIG_PROFILE
 void prof_pulse(uint16_t length) {
@@ -30,126 +33,370 @@ void prof_off() {
 #endif
 
 #if CONFIG_PROFILE == 1
-#define STATS_LENGTH 0x10
-#define STAT_NAME_LENGTH 0x10
+#ifndef CONFIG_PROFILE_SCOPES
+#define CONFIG_PROFILE_SCOPES 0x20
+#endif
+#define SCOPE_NAME_LENGTH 0x10
+#define SCOPE_DEPTH 0x8
+#define SCOPE_NONE 0xFFFF
+#define TASKS_LENGTH 0x20
+#define LATENCY_BUCKETS 0x20 // Bucket b holds latencies in [2^b, 2^(b + 1))
+
+// Recorded in the dump so tools/energy.py can pick its cost table
+#define PROF_STR_(s) #s
+#define PROF_STR(s) PROF_STR_(s)
+#ifdef CONFIG_BACKEND
+#define PROF_BACKEND PROF_STR(CONFIG_BACKEND)
+#else
+#define PROF_BACKEND ""
+#endif
+#if defined(__MSP430FR5994__)
+#define PROF_TARGET "msp430fr5994"
+#elif defined(__MSP430__)
+#define PROF_TARGET "msp430"
+#else
+#define PROF_TARGET "host"
+#endif
+
+#ifdef CONFIG_CONSOLE
+#define PROF_NAME(n) #n,
+static const char *prof_names[PROF_COUNTERS_LEN] = {
+	PROF_COUNTERS(PROF_NAME)
+};
+#undef PROF_NAME
+#endif
+
+typedef struct {
+	uint32_t min;
+	uint32_t max;
+} prof_range_t;
 
+// A scope is a name under a parent scope, every close adds one instance
 typedef struct {
-	char name[STAT_NAME_LENGTH];
-	uint32_t invocs;
-	uint32_t ops;
-} stat_t;
+	char name[SCOPE_NAME_LENGTH];
+	uint16_t parent;
+	uint16_t count;
+	prof_stat_t stats[PROF_COUNTERS_LEN]; // Summed over instances
+	prof_range_t range[PROF_COUNTERS_LEN]; // ops of a single instance
+} scope_t;
 
 typedef struct {
-	char name[STAT_NAME_LENGTH];
-	stat_t stats[STATS_LENGTH];
-	uint16_t stats_len;
-} section_t;
+	uint16_t scope;
+	prof_stat_t start[PROF_COUNTERS_LEN];
+} frame_t;
 
+// All of it is in FRAM, open scopes stay open across reboots
 typedef struct {
-	section_t overall;
-	section_t running;
-	section_t sections[STATS_LENGTH / 2];
-	uint16_t sections_len;
+	prof_stat_t running[PROF_COUNTERS_LEN]; // Start of the next SECTION
+	scope_t scopes[CONFIG_PROFILE_SCOPES];
+	uint16_t scopes_len;
+	frame_t stack[SCOPE_DEPTH];
+	uint16_t depth;
+	uint16_t dropped; // Scopes that did not fit
 } prof_t;
 
-static __fram prof_t profiler;
+typedef struct {
+	uint16_t uid;
+	uint16_t reboots; // Times the task was resumed after a power failure
+	uint32_t entries; // Transitions to the task plus resumes
+	uint32_t done; // Completions seen by task_cleanup
+	uint32_t iters; // Loop iterations kept
+	uint32_t redone; // Loop iterations lost to a power failure
+	bool running; // Entered and not completed yet
+	uint32_t start; // Time of the first entry
+	uint32_t max; // Longest latency
+	uint16_t latency[LATENCY_BUCKETS]; // Entry to completion, in timer ticks
+	uint32_t sat; // Saturation events
+} prof_task_t;
+
+__fram prof_stat_t prof_stats[PROF_COUNTERS_LEN];
+__fram uint32_t prof_pending;
+__fram uint32_t prof_persisted;
+// The scope and task tables take 10 to 20KB, kept out of lower FRAM
+static __hifram prof_t profiler;
+static __hifram prof_task_t prof_tasks[TASKS_LENGTH];
+static __fram uint16_t prof_tasks_len;
+
+#ifdef CONFIG_PROFILE_MEM
+// Counter of the first kind for the region p is in, on the host everything is
+// taken to be FRAM
+static uint16_t prof_mem_region(const void *p) {
+#ifdef __MSP430__
+	uintptr_t addr = (uintptr_t)p;
+	if(addr >= 0x10000) return PROF_HIFRAM_LD;
+	if(addr >= 0x4000) return PROF_FRAM_LD;
+	if(addr >= 0x2C00 && addr < 0x3C00) return PROF_LEARAM_LD;
+	return PROF_SRAM_LD;
+#else
+	return PROF_FRAM_LD;
+#endif
+}
+
+fixed *prof_mem(fixed *p, uint16_t kind) {
+	prof_stat_t *s = &prof_stats[prof_mem_region(p) + kind];
+	s->invocs++;
+	s->ops += sizeof(fixed);
+	return p;
+}
+
+// Charged to the destination, the data is copied there on commit
+void prof_mem_gbuf(uint8_t *dst, size_t len) {
+	prof_stat_t *s = &prof_stats[prof_mem_region(dst) + PROF_MEM_GBUF];
+	s->invocs++;
+	s->ops += len;
+}
+#endif
+
+#ifdef CONFIG_PROFILE_SAT
+static prof_task_t *prof_task(uint16_t uid);
+
+void prof_sat(prof_counter_t counter) {
+	prof_stats[counter].invocs++;
+	prof_stats[counter].ops++;
+	prof_task_t *t = prof_task(CUR_TASK->idx);
+	if(t != NULL) t->sat++;
+}
+#endif
+
+// Entry of uid, added on first use, NULL once the table is full
+static prof_task_t *prof_task(uint16_t uid) {
+	for(uint16_t i = 0; i < prof_tasks_len; i++) {
+		if(prof_tasks[i].uid == uid) return &prof_tasks[i];
+	}
+	if(prof_tasks_len == TASKS_LENGTH) return NULL;
+	prof_task_t *t = &prof_tasks[prof_tasks_len];
+	memset(t, 0, sizeof(prof_task_t));
+	t->uid = uid;
+	prof_tasks_len++;
+	return t;
+}
+
+// Everything the running task did up to here is committed by the transition
+void prof_transition(uint16_t uid) {
+	prof_task_t *t = prof_task(CUR_TASK->idx);
+	if(t != NULL) t->iters += prof_persisted + prof_pending;
+	prof_persisted = 0;
+	prof_pending = 0;
+	t = prof_task(uid);
+	if(t == NULL) return;
+	t->entries++;
+	if(!t->running) {
+		t->start = timer_now();
+		t->running = true;
+	}
+}
 
-void prof_inc(char *name, uint16_t invocs, uint16_t ops) {
-	uint16_t stats_len = profiler.overall.stats_len;
-	for(uint16_t i = 0; i < stats_len; i++) {
-		if(strcmp(name, profiler.overall.stats[i].name) == 0) {
-			profiler.overall.stats[i].invocs += invocs;
-			profiler.overall.stats[i].ops += ops;
-			return;
+// The latency spans reboots, re-executed work is part of it
+void prof_cleanup(uint16_t uid) {
+	prof_task_t *t = prof_task(uid);
+	if(t == NULL) return;
+	t->done++;
+	if(!t->running) return;
+	uint32_t latency = timer_now() - t->start;
+	uint16_t b = 0;
+	while(b < LATENCY_BUCKETS - 1 && (latency >> (b + 1))) b++;
+	if(t->latency[b] != UINT16_MAX) t->latency[b]++;
+	if(latency > t->max) t->max = latency;
+	t->running = false;
+}
+
+#ifdef CONFIG_CONSOLE
+// Upper bound of the bucket the p-th percentile falls in
+static uint32_t prof_percentile(prof_task_t *t, uint32_t count, uint16_t p) {
+	uint32_t seen = 0;
+	for(uint16_t b = 0; b < LATENCY_BUCKETS; b++) {
+		seen += t->latency[b];
+		if(seen * 100 >= count * p) {
+			uint32_t bound = b == LATENCY_BUCKETS - 1 ? UINT32_MAX : (2UL << b) - 1;
+			return bound < t->max ? bound : t->max;
 		}
 	}
-	strcpy(profiler.overall.stats[stats_len].name, name);
-	profiler.overall.stats[stats_len].invocs = invocs;
-	profiler.overall.stats[stats_len].ops = ops;
-	profiler.overall.stats_len++;
+	return t->max;
+}
+#endif
+
+// Whatever is still pending was lost with the power, the first boot finds the
+// entry task without entries and is not counted as a reboot
+void prof_boot() {
+	timer_boot();
+	prof_task_t *t = prof_task(CUR_TASK->idx);
+	if(t != NULL) {
+		t->iters += prof_persisted;
+		t->redone += prof_pending;
+		if(t->entries) t->reboots++;
+		t->entries++;
+	}
+	prof_persisted = 0;
+	prof_pending = 0;
+}
+
+static void prof_print_stats(prof_stat_t *stats, char *indent) {
+	bool first = true;
+	for(uint16_t i = 0; i < PROF_COUNTERS_LEN; i++) {
+		if(stats[i].invocs == 0 && stats[i].ops == 0) continue;
+		if(!first) PRINTF(",");
+		PRINTF("\r\n%s\"%s\": {\"invocs\": %n, \"ops\": %n}",
+			indent, prof_names[i], stats[i].invocs, stats[i].ops);
+		first = false;
+	}
+}
+
+static void prof_print_range(scope_t *scope, char *indent) {
+	bool first = true;
+	for(uint16_t i = 0; i < PROF_COUNTERS_LEN; i++) {
+		if(scope->stats[i].ops == 0) continue;
+		if(!first) PRINTF(",");
+		PRINTF("\r\n%s\"%s\": {\"min\": %n, \"max\": %n, \"avg\": %n}",
+			indent, prof_names[i], scope->range[i].min, scope->range[i].max,
+			scope->stats[i].ops / scope->count);
+		first = false;
+	}
+}
+
+static void prof_print_path(uint16_t s) {
+	if(profiler.scopes[s].parent != SCOPE_NONE) {
+		prof_print_path(profiler.scopes[s].parent);
+		PRINTF("/");
+	}
+	PRINTF("%s", profiler.scopes[s].name);
 }
 
 void prof_print() {
 	PRINTF("\r\n=========Stats=========");
 	PRINTF("\r\n[{");
-	PRINTF("\r\n\"backend\": \"\",");
-	PRINTF("\r\n\"target\": \"\",");
+	PRINTF("\r\n\"backend\": \"%s\",", PROF_BACKEND);
+	PRINTF("\r\n\"target\": \"%s\",", PROF_TARGET);
+	PRINTF("\r\n\"timer_hz\": %n,", (uint32_t)CONFIG_TIMER_HZ);
 	PRINTF("\r\n\"overall\": {");
-	for(uint16_t i = 0; i < profiler.overall.stats_len; i++) {
-		PRINTF("\r\n  \"%s\": {\"invocs\": %n, \"ops\": %n}",
-			profiler.overall.stats[i].name, 
-			profiler.overall.stats[i].invocs, 
-			profiler.overall.stats[i].ops);
-		if(i != profiler.overall.stats_len - 1) PRINTF(",");
-	}
+	prof_print_stats(prof_stats, "  ");
 	PRINTF("\r\n},");
+	PRINTF("\r\n\"dropped\": %u,", profiler.dropped);
 	PRINTF("\r\n\"sections\": {");
-	for(uint16_t i = 0; i < profiler.sections_len; i++) {
-		PRINTF("\r\n \"%s\": {\"idx\": 0, \"stats\": {", profiler.sections[i].name);
-		for(uint16_t j = 0; j < profiler.sections[i].stats_len; j++) {
-			PRINTF("\r\n  \"%s\": {\"invocs\": %n, \"ops\": %n}",
-				profiler.sections[i].stats[j].name, 
-				profiler.sections[i].stats[j].invocs, 
-				profiler.sections[i].stats[j].ops);
-			if(j != profiler.sections[i].stats_len - 1) PRINTF(",");
-		}
+	bool first = true;
+	for(uint16_t i = 0; i < profiler.scopes_len; i++) {
+		scope_t *scope = &profiler.scopes[i];
+		if(scope->count == 0) continue; // Still open
+		if(!first) PRINTF(",");
+		first = false;
+		PRINTF("\r\n \"");
+		prof_print_path(i);
+		PRINTF("\": {\"idx\": %u, \"parent\": %i, \"count\": %u, \"stats\": {",
+			i, scope->parent == SCOPE_NONE ? -1 : (int16_t)scope->parent,
+			scope->count);
+		prof_print_stats(scope->stats, "  ");
+		PRINTF("\r\n }, \"range\": {");
+		prof_print_range(scope, "  ");
 		PRINTF("\r\n }}");
-		if(i != profiler.sections_len - 1) PRINTF(",");
+	}
+	PRINTF("\r\n},");
+	PRINTF("\r\n\"tasks\": {");
+	for(uint16_t i = 0; i < prof_tasks_len; i++) {
+		prof_task_t *t = &prof_tasks[i];
+		PRINTF("\r\n \"%u\": {\"entries\": %n, \"done\": %n, \"reboots\": %u, "
+			"\"iters\": %n, \"redone\": %n, \"sat\": %n", t->uid, t->entries,
+			t->done, t->reboots, t->iters, t->redone, t->sat);
+		uint32_t count = 0;
+		uint16_t last = 0;
+		for(uint16_t b = 0; b < LATENCY_BUCKETS; b++) {
+			count += t->latency[b];
+			if(t->latency[b]) last = b;
+		}
+		if(count != 0) {
+			PRINTF(",\r\n  \"latency\": {\"p50\": %n, \"p99\": %n, \"max\": %n, "
+				"\"hist\": [", prof_percentile(t, count, 50),
+				prof_percentile(t, count, 99), t->max);
+			for(uint16_t b = 0; b <= last; b++) {
+				PRINTF(b ? ", %u" : "%u", t->latency[b]);
+			}
+			PRINTF("]}");
+		}
+		PRINTF("}");
+		if(i != prof_tasks_len - 1) PRINTF(",");
 	}
 	PRINTF("\r\n}");
 	PRINTF("\r\n}]");
 	PRINTF("\r\n=======================");
 }
 
-void prof(prof_control_t t, char *layer) {
+static bool prof_is(uint16_t s, char *name) {
+	return strncmp(profiler.scopes[s].name, name, SCOPE_NAME_LENGTH - 1) == 0;
+}
+
+static bool prof_is_open(char *name) {
+	for(uint16_t i = 0; i < profiler.depth; i++) {
+		if(prof_is(profiler.stack[i].scope, name)) return true;
+	}
+	return false;
+}
+
+// Scope name under parent, added on first use
+static uint16_t prof_scope(uint16_t parent, char *name) {
+	for(uint16_t i = 0; i < profiler.scopes_len; i++) {
+		if(profiler.scopes[i].parent == parent && prof_is(i, name)) return i;
+	}
+	if(profiler.scopes_len == CONFIG_PROFILE_SCOPES) {
+		profiler.dropped++;
+		return SCOPE_NONE;
+	}
+	scope_t *scope = &profiler.scopes[profiler.scopes_len];
+	memset(scope, 0, sizeof(scope_t));
+	strncpy(scope->name, name, SCOPE_NAME_LENGTH - 1);
+	scope->parent = parent;
+	profiler.scopes_len++;
+	return profiler.scopes_len - 1;
+}
+
+// Adds one instance of s that started at start
+static void prof_record(uint16_t s, prof_stat_t *start) {
+	scope_t *scope = &profiler.scopes[s];
+	for(uint16_t i = 0; i < PROF_COUNTERS_LEN; i++) {
+		uint32_t ops = prof_stats[i].ops - start[i].ops;
+		scope->stats[i].invocs += prof_stats[i].invocs - start[i].invocs;
+		scope->stats[i].ops += ops;
+		if(scope->count == 0 || ops < scope->range[i].min)
+			scope->range[i].min = ops;
+		if(scope->count == 0 || ops > scope->range[i].max)
+			scope->range[i].max = ops;
+	}
+	scope->count++;
+}
+
+// OPEN and CLOSE nest (network, layer, kernel, tile), SECTION adds a leaf
+// under the innermost open scope covering everything since the last call.
+// A task re-executed after a reboot opens and closes its scopes again, so an
+// OPEN of a scope that is still open (at any depth, the task may have opened
+// more under it) and a CLOSE of a scope that is not innermost are ignored.
+void prof(prof_control_t t, char *name) {
+	uint16_t top = profiler.depth ?
+		profiler.stack[profiler.depth - 1].scope : SCOPE_NONE;
 	switch(t) {
-		case SECTION:
-			if(profiler.sections_len == 0) {
-				strcpy(profiler.sections[0].name, layer);
-				profiler.sections[0].stats_len = profiler.overall.stats_len;
-				for(uint16_t i = 0; i < profiler.overall.stats_len; i++) {
-					strcpy(profiler.sections[0].stats[i].name, 
-						profiler.overall.stats[i].name);
-					profiler.sections[0].stats[i].invocs = 
-						profiler.overall.stats[i].invocs;
-					profiler.sections[0].stats[i].ops = 
-						profiler.overall.stats[i].ops;
-					profiler.running.stats[i].invocs = 
-						profiler.overall.stats[i].invocs;
-					profiler.running.stats[i].ops = 
-						profiler.overall.stats[i].ops;
-				}
-				profiler.sections_len++;
-			} else {
-				strcpy(profiler.sections[profiler.sections_len].name, layer);
-				uint16_t stats_len = 
-					profiler.sections[profiler.sections_len - 1].stats_len;
-				profiler.sections[profiler.sections_len].stats_len = stats_len;
-				for(uint16_t i = 0; i < profiler.overall.stats_len; i++) {
-					if(i > profiler.sections[profiler.sections_len - 1].stats_len) {
-						strcpy(profiler.sections[profiler.sections_len].stats[i].name,
-							profiler.overall.stats[i].name);
-						profiler.sections[profiler.sections_len].stats[i].invocs = 
-							profiler.overall.stats[i].invocs;
-						profiler.sections[profiler.sections_len].stats[i].ops = 
-							profiler.overall.stats[i].ops;
-						continue;
-					}
-					strcpy(profiler.sections[profiler.sections_len].stats[i].name,
-						profiler.sections[profiler.sections_len - 1].stats[i].name);
-					profiler.sections[profiler.sections_len].stats[i].invocs = 
-						profiler.overall.stats[i].invocs - 
-						profiler.running.stats[i].invocs;
-					profiler.sections[profiler.sections_len].stats[i].ops = 
-						profiler.overall.stats[i].ops - 
-						profiler.running.stats[i].ops;
-					profiler.running.stats[i].invocs = 
-						profiler.overall.stats[i].invocs;
-					profiler.running.stats[i].ops = 
-						profiler.overall.stats[i].ops;
-				}
-				profiler.sections_len++;
+		case OPEN: {
+			if(prof_is_open(name)) break;
+			if(profiler.depth == SCOPE_DEPTH) {
+				profiler.dropped++;
+				break;
 			}
+			uint16_t s = prof_scope(top, name);
+			if(s == SCOPE_NONE) break;
+			frame_t *frame = &profiler.stack[profiler.depth];
+			frame->scope = s;
+			memcpy(frame->start, prof_stats, sizeof(prof_stats));
+			memcpy(profiler.running, prof_stats, sizeof(prof_stats));
+			profiler.depth++;
+			break;
+		}
+		case SECTION: {
+			uint16_t s = prof_scope(top, name);
+			if(s != SCOPE_NONE) prof_record(s, profiler.running);
+			memcpy(profiler.running, prof_stats, sizeof(prof_stats));
+			break;
+		}
+		case CLOSE:
+			if(top == SCOPE_NONE || !prof_is(top, name)) break;
+			prof_record(top, profiler.stack[profiler.depth - 1].start);
+			memcpy(profiler.running, prof_stats, sizeof(prof_stats));
+			profiler.depth--;
+			break;
 		default: break;
 	}
 }
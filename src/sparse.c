@@ -0,0 +1,210 @@
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "mem.h"
+#include "blas.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "profile.h"
+#include "cleanup.h"
+#include "sparse.h"
+
+TASK(TASK_UID_SPARSE_OFFSET + 0, task_svsv_mul);
+TASK(TASK_UID_SPARSE_OFFSET + 1, task_smm_mul);
+TASK(TASK_UID_SPARSE_OFFSET + 2, task_relu_pack);
+
+__fram uint16_t nz_idx[CONFIG_NZ_LEN];
+static __fram mat_t *packed[CONFIG_ACT_PACKED];
+
+uint16_t nz_build(mat_t *v) {
+	uint16_t len = MAT_GET_DIM(v, 0);
+	if(len > CONFIG_NZ_LEN) return NZ_DENSE;
+	uint16_t max = len - (len >> 2);
+	uint16_t n = 0;
+	fixed *ptr = v->data;
+	for(uint16_t j = 0; j < len; j++) {
+		if(*ptr++ == F_LIT(0.0)) continue;
+		if(n == max) return NZ_DENSE;
+		nz_idx[n++] = j;
+	}
+	return n;
+}
+
+// CSR weights times a sparse activation vector. The nonzeros of src are
+// gathered into nz_idx first (scratch 2 keeps how many), then each row's
+// ascending column offsets are merge-joined with them, so only the activations
+// a row shares with its weights are loaded. A dense src is handed to
+// task_svm_mul. Rows are computed whole and written once, the row count
+// persists in scratch 1.
+void task_svsv_mul() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+
+	if(CUR_SCRATCH[0] == 0) {
+		uint16_t n = nz_build(src);
+		if(n == NZ_DENSE) {
+			TASK_REF(task_svm_mul)->info.return_task = 
+				CUR_TASK->info.return_task;
+			TRANSITION_TO(task_svm_mul);
+		}
+		PRINTF("\r\n     %u nonzero inputs", n);
+		scratch_bak[0] = 1;
+		scratch_bak[2] = n;
+		write_to_gbuf((uint8_t *)(scratch_bak),
+			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+		write_to_gbuf((uint8_t *)(scratch_bak + 2),
+			(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	uint16_t nz = CUR_SCRATCH[2];
+	uint16_t rows = MAT_GET_DIM(dest, 0);
+	prof_pulse(0x10);
+	for(uint16_t i = CUR_SCRATCH[1]; i < rows; i = ++CUR_SCRATCH[1]) {
+		prof_inc(loop_inc, 1, 1);
+		prof_persist();
+		prof_iter(1);
+		uint16_t j = filter->sparse.sizes[i];
+		uint16_t end = filter->sparse.sizes[i + 1];
+		uint16_t n = 0;
+		prof_inc(ld, 2, 2);
+		acc_t w = (acc_t)FC_BIAS(i) * F_ONE;
+		while(j < end && n < nz) {
+			prof_inc(loop_inc, 1, 1);
+			uint16_t col = filter->sparse.offsets[j];
+			uint16_t act = nz_idx[n];
+			prof_inc(ld, 2, 2);
+			if(col < act) {
+				j++;
+			} else if(col > act) {
+				n++;
+			} else {
+				w += ACC_MUL(MAT_GET(filter, j), src->data[col]);
+				j++;
+				n++;
+				prof_inc(ld, 2, 2);
+				prof_inc(mul, 1, 1);
+				prof_inc(add, 1, 1);
+			}
+		}
+		MAT_SET(dest, FC_RELU(acc_round(w)), i, 0);
+		prof_inc(MAT_SET_2D, 1, 1);
+	}
+	prof_pulse(0x10);
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
+
+// Sparse weights times a [cols, N] matrix of N samples, dest is [rows, N].
+// Each weight and offset is loaded once per CONFIG_SMM_COLS samples, bias and
+// ReLU as for task_svsv_mul. Rows are written whole, the row count persists.
+void task_smm_mul() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+
+	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t batch = MAT_GET_DIM(src, 1);
+	acc_t acc[CONFIG_SMM_COLS];
+	prof_pulse(0x10);
+	for(uint16_t i = CUR_SCRATCH[0]; i < rows; i = ++CUR_SCRATCH[0]) {
+		uint16_t start = filter->sparse.sizes[i];
+		uint16_t end = filter->sparse.sizes[i + 1];
+		acc_t bias = (acc_t)FC_BIAS(i) * F_ONE;
+		prof_persist();
+		for(uint16_t c = 0; c < batch; c += CONFIG_SMM_COLS) {
+			uint16_t len = (batch - c < CONFIG_SMM_COLS) ? 
+				batch - c : CONFIG_SMM_COLS;
+			for(uint16_t n = 0; n < len; n++) acc[n] = bias;
+			fixed *filter_ptr = MAT_PTR(filter, start);
+			uint16_t *offset = filter->sparse.offsets + start;
+			for(uint16_t j = start; j < end; j++) {
+				prof_iter(1);
+				fixed f = *filter_ptr++;
+				fixed *src_ptr = MAT_PTR(src, *offset++, c);
+				for(uint16_t n = 0; n < len; n++) {
+					acc[n] += ACC_MUL(f, src_ptr[n]);
+				}
+			}
+			fixed *dest_ptr = MAT_PTR(dest, i, c);
+			for(uint16_t n = 0; n < len; n++) {
+				dest_ptr[n] = FC_RELU(acc_round(acc[n]));
+			}
+		}
+	}
+	prof_pulse(0x10);
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
+
+bool act_is_packed(mat_t *m) {
+	for(uint16_t i = 0; i < CONFIG_ACT_PACKED; i++) {
+		if(packed[i] == m) return true;
+	}
+	return false;
+}
+
+void act_set_packed(mat_t *m, bool on) {
+	mat_t **slot = NULL;
+	for(uint16_t i = 0; i < CONFIG_ACT_PACKED; i++) {
+		if(packed[i] == m) {
+			if(!on) packed[i] = NULL;
+			return;
+		}
+		if(slot == NULL && packed[i] == NULL) slot = &packed[i];
+	}
+	if(!on) return;
+	if(slot == NULL) {
+		PRINTF("\r\n No slot for a packed tensor");
+		return;
+	}
+	*slot = m;
+}
+
+// For the tasks that only read dense tensors, a packed m stops the app
+void act_dense(mat_t *m) {
+	if(!act_is_packed(m)) return;
+	PRINTF("\r\n Packed tensor read as dense");
+	while(1) {}
+}
+
+// ReLU of a [C, H, W] src into a packed dest (not src itself), a row at a
+// time. A row's first value index follows from the row before it, so only the
+// row count persists and a row cut off by a reboot is just written again.
+void task_relu_pack() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	uint16_t rows = act_rows(src);
+	uint16_t cols = MAT_GET_DIM(src, 2);
+	fixed *vals = act_vals(dest);
+	if(CUR_SCRATCH[0] == 0) act_set_packed(dest, false);
+	for(uint16_t r = CUR_SCRATCH[0]; r < rows; r = ++CUR_SCRATCH[0]) {
+		prof_iter(1);
+		uint16_t *bits = act_bits(dest, r);
+		uint16_t *base = act_base(dest, r);
+		uint16_t idx = (r == 0) ? 0 : base[-1] + act_count(bits[-1]);
+		fixed *src_ptr = src->data + (idx_t)r * cols;
+		for(uint16_t x = 0; x < cols; x += 16) {
+			uint16_t word = 0;
+			uint16_t len = (cols - x < 16) ? cols - x : 16;
+			base[x >> 4] = idx;
+			for(uint16_t b = 0; b < len; b++) {
+				fixed v = *src_ptr++;
+				if(!F_LT(F_LIT(0.0), v)) continue;
+				word |= 1u << b;
+				vals[idx++] = v;
+			}
+			bits[x >> 4] = word;
+		}
+	}
+	act_set_packed(dest, true);
+	POP_STACK(mat_stack, 2);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
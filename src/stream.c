@@ -0,0 +1,233 @@
+#ifndef __MSP430__
+#include <stdio.h> // Before misc.h stubs out printf
+#endif
+#include "stream.h"
+
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "blas.h"
+#include "mem.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "cleanup.h"
+
+static __fram stream_t *streams;
+static __fram uint16_t len_streams;
+static __fram mat_t c_filter, c_dest;
+static __fram mat_t *c_filter_ptr = &c_filter;
+static __fram mat_t *c_dest_ptr = &c_dest;
+static __fram fixed *c_bias; // params.bias of the layer, moved along by row
+
+// Kept in SRAM on purpose, a prefetch in flight is lost on a power failure
+// and the block is just read again
+static stream_t *prefetched_stream = NULL;
+static uint16_t prefetched = STREAM_NONE;
+static uint16_t prefetched_half;
+
+#ifndef __MSP430__
+static FILE *stream_file = NULL;
+
+bool stream_open(const char *path) {
+	stream_file = fopen(path, "rb");
+	return stream_file != NULL;
+}
+
+void stream_close(void) {
+	if(stream_file != NULL) fclose(stream_file);
+	stream_file = NULL;
+}
+
+void stream_read(uint32_t addr, uint8_t *dest, uint16_t len) {
+	fseek(stream_file, addr, SEEK_SET);
+	if(fread(dest, 1, len, stream_file) != len) {
+		PRINTF("\r\n Short stream read at %n", addr);
+	}
+}
+#endif
+
+__attribute__((weak)) void stream_prefetch(uint32_t addr, uint8_t *dest,
+	uint16_t len) {
+	stream_read(addr, dest, len);
+}
+
+__attribute__((weak)) void stream_wait(void) {}
+
+// Words a single filter (values, offsets and the offset past them) or a single
+// CSR row (two sizes, offsets and values) of w takes when staged alone
+static uint32_t stream_need(mat_t *w) {
+	uint32_t need = 0;
+	if(w->sparse.len_dims > 2) { // Conv, sizes counts the values per filter
+		for(uint16_t i = 0; i < w->sparse.dims[0]; i++) {
+			uint32_t n = 2 * (uint32_t)w->sparse.sizes[i] + 1;
+			if(n > need) need = n;
+		}
+		return need;
+	}
+	for(uint16_t r = 0; r < w->sparse.dims[0]; r++) { // FC, sizes is CSR
+		uint32_t n = 2 + 
+			2 * (uint32_t)(w->sparse.sizes[r + 1] - w->sparse.sizes[r]);
+		if(n > need) need = n;
+	}
+	return need;
+}
+
+// A weight with a filter or row that doesn't fit in MAT_BUFFER(2) stops the
+// app here, it would be staged past the buffer
+void stream_register(stream_t *table, uint16_t len) {
+	for(uint16_t i = 0; i < len; i++) {
+		if(stream_need(table[i].mat) > CONFIG_MAT_BUF_SIZE) {
+			PRINTF("\r\n Streamed weight %u exceeds the stream buffer", i);
+			while(1) {}
+		}
+	}
+	streams = table;
+	len_streams = len;
+}
+
+stream_t *stream_find(mat_t *w) {
+	for(uint16_t i = 0; i < len_streams; i++) {
+		if(streams[i].mat == w) return &streams[i];
+	}
+	return NULL;
+}
+
+// Claims the staged block id of s, returns the half it was prefetched into or
+// STREAM_NONE when it has to be read now
+static uint16_t stream_claim(stream_t *s, uint16_t id) {
+	uint16_t half = STREAM_NONE;
+	if(prefetched != STREAM_NONE) {
+		stream_wait();
+		if(prefetched_stream == s && prefetched == id) half = prefetched_half;
+	}
+	prefetched = STREAM_NONE;
+	return half;
+}
+
+static void stream_start(stream_t *s, uint16_t id, uint16_t half) {
+	prefetched_stream = s;
+	prefetched = id;
+	prefetched_half = half;
+}
+
+// Stages len values of a conv filter followed by len + 1 offsets, the kernels
+// read one offset past the last value
+static void stream_fetch_filter(stream_t *s, bool async, idx_t first,
+	uint16_t len, fixed *buf) {
+	void (*read)(uint32_t, uint8_t *, uint16_t) =
+		async ? stream_prefetch : stream_read;
+	read(s->data + first * sizeof(fixed), (uint8_t *)buf, len * sizeof(fixed));
+	read(s->offsets + first * sizeof(uint16_t), (uint8_t *)(buf + len),
+		(len + 1) * sizeof(uint16_t));
+}
+
+// Points filter i of a streamed conv weight (constrained to filter as in
+// task_s_conv) at a staged copy, then prefetches the next non-empty filter
+void stream_filter(stream_t *s, mat_t *filter, uint16_t i,
+	idx_t running_size) {
+	mat_t *w = s->mat;
+	uint16_t len = w->sparse.sizes[i];
+	uint16_t half = stream_claim(s, i);
+	if(half == STREAM_NONE) {
+		half = 0;
+		stream_fetch_filter(s, false, running_size, len, STREAM_BUF(half));
+	}
+	filter->data = STREAM_BUF(half);
+	filter->sparse.offsets = (uint16_t *)(STREAM_BUF(half) + len);
+	if(2 * len + 1 > STREAM_HALF) return; // Took the whole buffer
+
+	uint16_t filters = w->sparse.dims[0];
+	running_size += len;
+	for(i++; i < filters && w->sparse.sizes[i] == 0; i++);
+	if(i < filters && 2 * w->sparse.sizes[i] + 1 <= STREAM_HALF) {
+		stream_start(s, i, half ^ 1);
+		stream_fetch_filter(s, true, running_size, w->sparse.sizes[i],
+			STREAM_BUF(half ^ 1));
+	}
+}
+
+// Last row of the CSR block starting at row r0 that fits in cap words, as
+// sizes (rebased), offsets and values
+static uint16_t stream_rows(mat_t *w, uint16_t r0, uint16_t rows,
+	uint16_t cap) {
+	uint16_t r1 = r0 + 1;
+	while(r1 < rows && (r1 + 1 - r0 + 1) +
+		2 * (w->sparse.sizes[r1 + 1] - w->sparse.sizes[r0]) <= cap) r1++;
+	return r1;
+}
+
+static void stream_fetch_rows(stream_t *s, bool async, uint16_t r0,
+	uint16_t r1, fixed *buf) {
+	mat_t *w = s->mat;
+	void (*read)(uint32_t, uint8_t *, uint16_t) =
+		async ? stream_prefetch : stream_read;
+	uint16_t first = w->sparse.sizes[r0];
+	uint16_t len = w->sparse.sizes[r1] - first;
+	uint16_t *sizes = (uint16_t *)buf;
+	for(uint16_t r = r0; r <= r1; r++) {
+		*sizes++ = w->sparse.sizes[r] - first;
+	}
+	read(s->offsets + (uint32_t)first * sizeof(uint16_t), (uint8_t *)sizes,
+		len * sizeof(uint16_t));
+	read(s->data + (uint32_t)first * sizeof(fixed),
+		(uint8_t *)(sizes + len), len * sizeof(fixed));
+}
+
+// Public tasks
+TASK(TASK_UID_STREAM_OFFSET, task_svm_mul_stream);
+
+// Sparse vector-matrix multiplication with streamed weights, one block of
+// rows at a time through task_svm_mul
+void task_svm_mul_stream() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	stream_t *s = stream_find(PEEK_STACK(mat_stack, 2));
+	mat_t *w = s->mat;
+	uint16_t rows = MAT_GET_DIM(dest, 0);
+	uint16_t r0 = CUR_SCRATCH[0];
+	if(r0 == 0) c_bias = params.bias;
+	if(r0 < rows) {
+		uint16_t half = stream_claim(s, r0);
+		uint16_t r1 = stream_rows(w, r0, rows, STREAM_HALF);
+		if(half == STREAM_NONE) {
+			half = 0;
+			if(r1 == r0 + 1) r1 = stream_rows(w, r0, rows, CONFIG_MAT_BUF_SIZE);
+			stream_fetch_rows(s, false, r0, r1, STREAM_BUF(half));
+		}
+		uint16_t len = w->sparse.sizes[r1] - w->sparse.sizes[r0];
+		PRINTF("\r\n     Streaming rows %u-%u", r0, r1);
+		uint16_t *sizes = (uint16_t *)STREAM_BUF(half);
+		MAT_RESHAPE(c_filter_ptr, len);
+		c_filter.sparse.sizes = sizes;
+		c_filter.sparse.offsets = sizes + (r1 - r0 + 1);
+		c_filter.data = (fixed *)(c_filter.sparse.offsets + len);
+		c_dest = MAT_CONSTRAIN(dest, r0);
+		MAT_RESHAPE(c_dest_ptr, r1 - r0, 1);
+
+		// Fetch the next block while this one is multiplied
+		uint16_t r2 = r1 < rows ? stream_rows(w, r1, rows, STREAM_HALF) : r1;
+		if(r1 < rows && (r2 - r1 + 1) +
+			2 * (w->sparse.sizes[r2] - w->sparse.sizes[r1]) <= STREAM_HALF &&
+			(r1 - r0 + 1) + 2 * len <= STREAM_HALF) {
+			stream_start(s, r1, half ^ 1);
+			stream_fetch_rows(s, true, r1, r2, STREAM_BUF(half ^ 1));
+		}
+
+		params.bias = (c_bias == NULL) ? NULL : c_bias + r0;
+		TASK_REF(task_svm_mul)->info.return_task = CUR_TASK;
+		// Assumes filter, dest, src in that order
+		PUSH_STACK(mat_stack, c_filter_ptr, c_dest_ptr, src);
+		scratch_bak[0] = r1;
+		write_to_gbuf((uint8_t *)(scratch_bak),
+			(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+		TRANSITION_TO(task_svm_mul);
+	}
+	params.bias = c_bias;
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
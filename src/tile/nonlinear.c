@@ -10,6 +10,7 @@
 #include "state.h"
 #include "misc.h"
 #include "cleanup.h"
+#include "sparse.h"
 #include "tile.h"
 
 // Public tasks
@@ -21,6 +22,7 @@ TASK(TASK_UID_NONLINEAR_OFFSET + 4, task_transpose);
 void task_pool() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	act_dense(src);
 
 	uint16_t layers = MAT_GET_DIM(src, 0);
 	uint16_t rows = MAT_GET_DIM(src, 1);
@@ -29,6 +31,7 @@ void task_pool() {
 	uint16_t i = CUR_SCRATCH[0];
 	uint16_t j = CUR_SCRATCH[1];
 	uint16_t k = CUR_SCRATCH[2];
+	prof_iter(1);
 	fixed max = MAT_GET(src, i, j, k);
 	for(uint16_t l = 0; l < params.size[1]; l ++) {
 		for(uint16_t m = 0; m < params.size[2]; m ++) {
@@ -58,6 +61,7 @@ void task_pool() {
 		 CUR_SCRATCH[2] + params.stride[2] == cols)) {
 		transition_to(CUR_TASK);
 	}
+	pool_hop();
 	POP_STACK(mat_stack, 2);
 	setup_cleanup(CUR_TASK);
 	TRANSITION_TO(task_cleanup);
@@ -105,21 +109,21 @@ void task_filter() {
 void task_relu() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
-	uint16_t total_elements = MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1);
+	idx_t total_elements = (idx_t)MAT_GET_DIM(src, 0) * MAT_GET_DIM(src, 1);
 	if(src->len_dims == 3) {
 		total_elements *= MAT_GET_DIM(src, 2);
 	}
 	fixed max = F_LIT(0.0);
 	uint16_t tile_size = greatest_tile_size(total_elements, CONFIG_TILE_SIZE);
 	for(uint16_t i = 0; i < tile_size; i++) {
-		uint16_t idx_i = CUR_SCRATCH[0] + i;
+		idx_t idx_i = IDX_SCRATCH(0) + i;
 		max = *(src->data + idx_i);
 		*(dest->data + idx_i) = (F_LT(max, F_LIT(0.0))) ? F_LIT(0.0) : max;
 	}
-	scratch_bak[0] = CUR_SCRATCH[0] + tile_size;
+	IDX_BAK(0) = IDX_SCRATCH(0) + tile_size;
 	write_to_gbuf((uint8_t *)(scratch_bak), 
-		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
-	if(!(CUR_SCRATCH[0] + tile_size == total_elements)) {
+		(uint8_t *)(CUR_SCRATCH), sizeof(idx_t));
+	if(!(IDX_SCRATCH(0) + tile_size == total_elements)) {
 		transition_to(CUR_TASK);
 	}
 	POP_STACK(mat_stack, 2);
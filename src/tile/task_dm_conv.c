@@ -11,16 +11,20 @@
 #include "misc.h"
 #include "profile.h"
 #include "cleanup.h"
+#include "sparse.h"
 #include "tile.h"
 
 TASK(TASK_UID_BLAS_OFFSET + 6, task_dm_conv);
 
 static __fram fixed inter;
+static __fram acc_t acc, acc_bak;
 // Dense matrix convolution
 void task_dm_conv() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	batch_single(); // Tiles hold one frame
+	act_dense(src);
 
 	uint16_t rows = MAT_GET_DIM(dest, 0);
 	uint16_t cols = MAT_GET_DIM(dest, 1);
@@ -35,35 +39,50 @@ void task_dm_conv() {
 	uint16_t tile_size_y = greatest_tile_size(frows, CONFIG_TILE_SIZE);
 	uint16_t tile_size_x = greatest_tile_size(fcols, CONFIG_TILE_SIZE);
 
-	inter = 0;
-	for(uint16_t k = CUR_SCRATCH[2]; k < CUR_SCRATCH[2] + tile_size_z; k++) {
-		for(uint16_t l = CUR_SCRATCH[3]; l < CUR_SCRATCH[3] + tile_size_y; l++) {
-			for(uint16_t n = CUR_SCRATCH[4]; n < CUR_SCRATCH[4] + tile_size_x; n++) {
-				if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
-				j + n < MAT_GET_DIM(src, 2))) {
-					inter = F_ADD(inter, F_MUL(MAT_GET(filter, k, l, n), 
-						MAT_GET(src, k, i + l, j + n)));
+	uint16_t k = CUR_SCRATCH[2];
+	uint16_t l = CUR_SCRATCH[3];
+	uint16_t n = CUR_SCRATCH[4];
+	bool last = (k + tile_size_z == flayers && l + tile_size_y == frows && 
+		n + tile_size_x == fcols);
+
+	// Partial sum of the tiles before this one
+	acc_bak = (k != 0 || l != 0 || n != 0) ? acc : 0;
+	for(uint16_t kk = k; kk < k + tile_size_z; kk++) {
+		for(uint16_t ll = l; ll < l + tile_size_y; ll++) {
+			for(uint16_t nn = n; nn < n + tile_size_x; nn++) {
+				if(!params.same_padding || (i + ll < MAT_GET_DIM(src, 1) && 
+				j + nn < MAT_GET_DIM(src, 2))) {
+					acc_bak += ACC_MUL(MAT_GET(filter, kk, ll, nn), 
+						MAT_GET(src, kk, i + ll, j + nn));
 				}
 			}
 		}
 	}
 	uint16_t i_stride = i / params.stride[1];
 	uint16_t j_stride = j / params.stride[2];
-	if(CUR_SCRATCH[2] != 0 && CUR_SCRATCH[3] != 0 && CUR_SCRATCH[4] != 0) {
-		inter = F_ADD(inter, MAT_GET(dest, i_stride, j_stride));
+	if(last) {
+		inter = acc_round(acc_bak);
+		write_to_gbuf((uint8_t *)(&inter), 
+			(uint8_t *)(dest->data + cols * i_stride + j_stride), sizeof(fixed));
+	} else {
+		write_to_gbuf((uint8_t *)(&acc_bak), (uint8_t *)(&acc), sizeof(acc_t));
 	}
-	write_to_gbuf((uint8_t *)(&inter), 
-		(uint8_t *)(dest->data + cols * i_stride + j_stride), sizeof(fixed));
 
-	uint16_t k = CUR_SCRATCH[2];
-	uint16_t l = CUR_SCRATCH[3];
-	uint16_t n = CUR_SCRATCH[4];
+	// n, then l, then k, then the next output
 	scratch_bak[0] = CUR_SCRATCH[0];
 	scratch_bak[1] = CUR_SCRATCH[1];
-	scratch_bak[2] = (l + tile_size_y == frows) ? k + tile_size_z : k;
-	if(k + tile_size_z == flayers && l + tile_size_y == frows 
-		&& n + tile_size_x == fcols) {
-		scratch_bak[0] = CUR_SCRATCH[0];
+	scratch_bak[2] = k;
+	scratch_bak[3] = l;
+	scratch_bak[4] = n + tile_size_x;
+	if(n + tile_size_x == fcols) {
+		scratch_bak[4] = 0;
+		scratch_bak[3] = l + tile_size_y;
+		if(l + tile_size_y == frows) {
+			scratch_bak[3] = 0;
+			scratch_bak[2] = k + tile_size_z;
+		}
+	}
+	if(last) {
 		scratch_bak[1] = CUR_SCRATCH[1] + params.stride[2];
 		if(j + params.stride[2] >= params.stride[2] * cols) {
 			scratch_bak[0] = CUR_SCRATCH[0] + params.stride[1];
@@ -71,13 +90,6 @@ void task_dm_conv() {
 		}
 		scratch_bak[2] = 0;
 	}
-	scratch_bak[3] = l;
-	if(n + tile_size_x == fcols && l + tile_size_y == frows) {
-		scratch_bak[3] = 0;
-	} else if(n + tile_size_x == fcols) {
-		scratch_bak[3] = l + 1;
-	}
-	scratch_bak[4] = (n + tile_size_x == fcols) ? 0 : n + tile_size_x;
 	write_to_gbuf((uint8_t *)(scratch_bak), 
 		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
 	write_to_gbuf((uint8_t *)(scratch_bak + 1), 
@@ -88,7 +100,7 @@ void task_dm_conv() {
 		(uint8_t *)(CUR_SCRATCH + 3), sizeof(uint16_t));
 	write_to_gbuf((uint8_t *)(scratch_bak + 4), 
 		(uint8_t *)(CUR_SCRATCH + 4), sizeof(uint16_t));
-	if(!(CUR_SCRATCH[0] + params.stride[1] >= rows * params.stride[1] && 
+	if(!(last && CUR_SCRATCH[0] + params.stride[1] >= rows * params.stride[1] && 
 		CUR_SCRATCH[1] + params.stride[2] >= cols * params.stride[2]))
 		transition_to(CUR_TASK);
 	POP_STACK(mat_stack, 3);
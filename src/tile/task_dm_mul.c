@@ -17,8 +17,33 @@ TASK(TASK_UID_BLAS_OFFSET + 5, task_dm_mul);
 
 static __fram mat_t buf = {.data = LAYER_BUFFER(3)};
 static __fram mat_t *inter = &buf;
+static __fram acc_t acc[CONFIG_TILE_SIZE * CONFIG_TILE_SIZE];
+static __fram acc_t acc_bak[CONFIG_TILE_SIZE * CONFIG_TILE_SIZE];
 
-// Dense scalar multiplication
+// 2x2 block of outputs in w over n steps, f0 and f1 walk two filter rows and
+// s two src columns s1 apart (0 for a single column) down a stride of dcols.
+// Each step loads 4 operands for 4 MACs.
+static inline void block_2x2(acc_t *w, fixed *f0, fixed *f1, fixed *s, 
+	uint16_t s1, uint16_t dcols, uint16_t n) {
+	acc_t w00 = w[0], w01 = w[1], w10 = w[2], w11 = w[3];
+	for(uint16_t j = 0; j < n; j++) {
+		fixed a0 = *f0++;
+		fixed a1 = *f1++;
+		fixed b0 = s[0];
+		fixed b1 = s[s1];
+		w00 += ACC_MUL(a0, b0);
+		w01 += ACC_MUL(a0, b1);
+		w10 += ACC_MUL(a1, b0);
+		w11 += ACC_MUL(a1, b1);
+		s += dcols;
+	}
+	w[0] = w00;
+	w[1] = w01;
+	w[2] = w10;
+	w[3] = w11;
+}
+
+// Dense matrix multiplication
 void task_dm_mul() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
@@ -29,50 +54,61 @@ void task_dm_mul() {
 	uint16_t tile_size_x = greatest_tile_size(cols, CONFIG_TILE_SIZE);
 	uint16_t tile_size_y = greatest_common_tile_size(rows, dcols, CONFIG_TILE_SIZE);
 
-	MAT_RESHAPE(inter, tile_size_y, tile_size_x);
+	MAT_RESHAPE(inter, tile_size_y, tile_size_y);
 
+	// Reduction tiles go fastest, the partial sums of the output tile are
+	// kept wide in between
+	bool first = (CUR_SCRATCH[1] == 0);
+	bool last = (CUR_SCRATCH[1] + tile_size_x == cols);
 	prof_pulse(0x20);
-	for(uint16_t i = 0; i < tile_size_y; i++) {
-		uint16_t idx_i = CUR_SCRATCH[0] + i;
-		for(uint16_t k = 0; k < tile_size_y; k++) {
-			uint16_t idx_k = CUR_SCRATCH[2] + k;
-			fixed w = 0;
-			for(uint16_t j = 0; j < tile_size_x; j++) {
-				uint16_t idx_j = CUR_SCRATCH[1] + j;
-				fixed tmp = F_MUL(MAT_GET(filter, idx_i, idx_j), 
-					MAT_GET(src, idx_j, idx_k));
-				w = F_ADD(w, tmp);
+	for(uint16_t i = 0; i < tile_size_y; i += 2) {
+		uint16_t i1 = (i + 1 < tile_size_y) ? i + 1 : i; // Odd tile, redo i
+		fixed *f0 = MAT_PTR(filter, CUR_SCRATCH[0] + i, CUR_SCRATCH[1]);
+		fixed *f1 = f0 + (i1 - i) * cols;
+		for(uint16_t k = 0; k < tile_size_y; k += 2) {
+			uint16_t k1 = (k + 1 < tile_size_y) ? k + 1 : k;
+			prof_iter(1);
+			uint16_t p[4] = {i * tile_size_y + k, i * tile_size_y + k1, 
+				i1 * tile_size_y + k, i1 * tile_size_y + k1};
+			acc_t w[4];
+			for(uint16_t b = 0; b < 4; b++) {
+				w[b] = first ? 
+					(acc_t)FC_BIAS(CUR_SCRATCH[0] + (b < 2 ? i : i1)) * F_ONE : 
+					acc[p[b]];
+			}
+			block_2x2(w, f0, f1, MAT_PTR(src, CUR_SCRATCH[1], CUR_SCRATCH[2] + k), 
+				k1 - k, dcols, tile_size_x);
+			for(uint16_t b = 0; b < 4; b++) {
+				if(last) inter->data[p[b]] = FC_RELU(acc_round(w[b]));
+				else acc_bak[p[b]] = w[b];
 			}
-			if(CUR_SCRATCH[1] >= tile_size_x) 
-				w = F_ADD(w, MAT_GET(dest, idx_i, idx_k));
-			MAT_SET(inter, w, i, k);
-			uint16_t where = idx_i * dcols + idx_k;
-			write_to_gbuf((uint8_t *)(inter->data + i * tile_size_x + k), 
-				(uint8_t *)(dest->data + where), sizeof(fixed));
 		}
 	}
 	prof_pulse(0x20);
 
-	uint16_t i = CUR_SCRATCH[0];
-	uint16_t j = CUR_SCRATCH[1];
-	uint16_t k = CUR_SCRATCH[2];
-	// i
-	scratch_bak[0] = CUR_SCRATCH[0];
-	if(CUR_SCRATCH[1] + tile_size_x == cols) {
-		scratch_bak[0] = CUR_SCRATCH[0] + tile_size_y;
+	// One commit per tile, or per row of it for dest
+	if(last) {
+		for(uint16_t i = 0; i < tile_size_y; i++) {
+			write_to_gbuf((uint8_t *)(inter->data + i * tile_size_y), 
+				(uint8_t *)MAT_PTR(dest, CUR_SCRATCH[0] + i, CUR_SCRATCH[2]), 
+				sizeof(fixed) * tile_size_y);
+		}
+	} else {
+		write_to_gbuf((uint8_t *)acc_bak, (uint8_t *)acc, 
+			sizeof(acc_t) * tile_size_y * tile_size_y);
 	}
-	// j
-	scratch_bak[1] = CUR_SCRATCH[1];
-	if(CUR_SCRATCH[1] + tile_size_x == cols && 
-		CUR_SCRATCH[2] + tile_size_y == dcols) {
+
+	// j, then k, then i
+	scratch_bak[0] = CUR_SCRATCH[0];
+	scratch_bak[1] = CUR_SCRATCH[1] + tile_size_x;
+	scratch_bak[2] = CUR_SCRATCH[2];
+	if(last) {
 		scratch_bak[1] = 0;
-	} else if(CUR_SCRATCH[2] + tile_size_y == dcols) {
-		scratch_bak[1] = CUR_SCRATCH[1] + tile_size_x;
-	}
-	// k
-	scratch_bak[2] = CUR_SCRATCH[2] + tile_size_y;
-	if(CUR_SCRATCH[2] + tile_size_y == dcols) {
-		scratch_bak[2] = 0;
+		scratch_bak[2] = CUR_SCRATCH[2] + tile_size_y;
+		if(CUR_SCRATCH[2] + tile_size_y == dcols) {
+			scratch_bak[2] = 0;
+			scratch_bak[0] = CUR_SCRATCH[0] + tile_size_y;
+		}
 	}
 	write_to_gbuf((uint8_t *)(scratch_bak), 
 		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
@@ -80,8 +116,7 @@ void task_dm_mul() {
 		(uint8_t *)(CUR_SCRATCH + 1), sizeof(uint16_t));
 	write_to_gbuf((uint8_t *)(scratch_bak + 2), 
 		(uint8_t *)(CUR_SCRATCH + 2), sizeof(uint16_t));
-	if(!(CUR_SCRATCH[0] + tile_size_y == rows && 
-		CUR_SCRATCH[1] + tile_size_x == cols && 
+	if(!(CUR_SCRATCH[0] + tile_size_y == rows && last && 
 		CUR_SCRATCH[2] + tile_size_y == dcols)) {
 		transition_to(CUR_TASK);	
 	}
@@ -0,0 +1,69 @@
+#include <string.h>
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+#include <libfixed/fixed.h>
+#include <libmat/mat.h>
+
+#include "mem.h"
+#include "blas.h"
+#include "state.h"
+#include "buffer.h"
+#include "misc.h"
+#include "profile.h"
+#include "cleanup.h"
+#include "tile.h"
+#include "sparse.h"
+
+TASK(TASK_UID_BLAS_OFFSET + 7, task_dmv_mul);
+
+static __fram fixed inter[CONFIG_TILE_SIZE];
+
+// Dense matrix vector multiplication, a tile of rows at a time
+void task_dmv_mul() {
+	mat_t *src = PEEK_STACK(mat_stack, 0);
+	mat_t *dest = PEEK_STACK(mat_stack, 1);
+	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	uint16_t rows = MAT_GET_DIM(filter, 0);
+	uint16_t cols = MAT_GET_DIM(filter, 1);
+	uint16_t tile_size = greatest_tile_size(rows, CONFIG_TILE_SIZE);
+
+	if(CUR_SCRATCH[1] == 0) { // Nonzeros of src, nz_idx is rebuilt if interrupted
+		scratch_bak[1] = 1;
+		scratch_bak[2] = nz_build(src);
+		write_to_gbuf((uint8_t *)(scratch_bak + 1), 
+			(uint8_t *)(CUR_SCRATCH + 1), 2 * sizeof(uint16_t));
+		transition_to(CUR_TASK);
+	}
+	uint16_t nz = CUR_SCRATCH[2];
+
+	uint16_t cur_row = CUR_SCRATCH[0];
+	prof_pulse(0x20);
+	for(uint16_t i = 0; i < tile_size; i++) {
+		prof_iter(1);
+		fixed *filter_ptr = MAT_PTR(filter, cur_row + i, 0);
+		fixed *src_ptr = src->data;
+		acc_t w = (acc_t)FC_BIAS(cur_row + i) * F_ONE;
+		if(nz != NZ_DENSE) {
+			for(uint16_t n = 0; n < nz; n++) {
+				uint16_t j = nz_idx[n];
+				w += ACC_MUL(filter_ptr[j], src_ptr[j]);
+			}
+		} else {
+			for(uint16_t j = 0; j < cols; j++) {
+				w += ACC_MUL(*filter_ptr++, *src_ptr++);
+			}
+		}
+		inter[i] = FC_RELU(acc_round(w));
+		write_to_gbuf((uint8_t *)(inter + i), 
+			(uint8_t *)MAT_PTR(dest, cur_row + i, 0), sizeof(fixed));
+	}
+	prof_pulse(0x20);
+
+	scratch_bak[0] = cur_row + tile_size;
+	write_to_gbuf((uint8_t *)(scratch_bak), 
+		(uint8_t *)(CUR_SCRATCH), sizeof(uint16_t));
+	if(cur_row + tile_size < rows) transition_to(CUR_TASK);
+	POP_STACK(mat_stack, 3);
+	setup_cleanup(CUR_TASK);
+	TRANSITION_TO(task_cleanup);
+}
\ No newline at end of file
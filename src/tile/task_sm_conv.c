@@ -22,6 +22,7 @@ void task_sm_conv() {
 	mat_t *src = PEEK_STACK(mat_stack, 0);
 	mat_t *dest = PEEK_STACK(mat_stack, 1);
 	mat_t *filter = PEEK_STACK(mat_stack, 2);
+	batch_single(); // Tiles hold one frame
 
 	uint16_t rows = MAT_GET_DIM(dest, 0);
 	uint16_t cols = MAT_GET_DIM(dest, 1);
@@ -59,6 +60,7 @@ void task_sm_conv() {
 		i < CUR_SCRATCH[2] + tile_size_y; i += params.stride[1]){
 		for(uint16_t j = init_j; 
 			j < CUR_SCRATCH[3] + tile_size_x; j += params.stride[2]){
+			prof_iter(1);
 			fixed w = 0;
 			if(!params.same_padding || (i + l < MAT_GET_DIM(src, 1) && 
 				j + n < MAT_GET_DIM(src, 2))) {
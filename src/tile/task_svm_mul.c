@@ -33,8 +33,10 @@ void task_svm_mul() {
 	uint16_t j = CUR_SCRATCH[1]; // data/col index
 	prof_pulse(0x10);
 	for(uint16_t i = cur_row; i < cur_row + tile_size; i++) {
-		if(j >= (filter->sparse.sizes[i + 1] - filter->sparse.sizes[i])) {
-			if(j == 0) MAT_SET(dest, F_LIT(0), i, 0); // Empty row
+		prof_iter(1);
+		uint16_t len = filter->sparse.sizes[i + 1] - filter->sparse.sizes[i];
+		if(j >= len) {
+			if(j == 0) MAT_SET(dest, FC_RELU(FC_BIAS(i)), i, 0); // Empty row
 			else MAT_SET(dest, MAT_GET(inter, i, 0), i, 0);
 			continue;
 		}
@@ -44,7 +46,10 @@ void task_svm_mul() {
 		w = F_MUL(f, w);
 		if(j != 0) {
 			w = F_ADD(MAT_GET(inter, i, 0), w); // Add partial
+		} else if(params.bias != NULL) {
+			w = F_ADD(FC_BIAS(i), w);
 		}
+		if(j + 1 == len) w = FC_RELU(w); // Done with the row
 		MAT_SET(inter, w, i, 0);
 		write_to_gbuf((uint8_t *)(inter->data + i), 
 			(uint8_t *)(dest->data + i), sizeof(fixed));
@@ -1,6 +1,6 @@
 #include "tile.h"
 
-uint16_t greatest_tile_size(uint16_t a, uint16_t max) {
+uint16_t greatest_tile_size(idx_t a, uint16_t max) {
 	uint16_t i = 1;
 	uint16_t max_divisor = i;
 	while(i < max && i <= a) {
@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 
-uint16_t greatest_tile_size(uint16_t a, uint16_t max);
+#include "misc.h"
+
+uint16_t greatest_tile_size(idx_t a, uint16_t max);
 uint16_t greatest_common_tile_size(uint16_t a, uint16_t b, uint16_t max);
 
 #endif
\ No newline at end of file
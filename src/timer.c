@@ -0,0 +1,78 @@
+#include "timer.h"
+
+#include <stdbool.h>
+#include <msp430.h>
+#ifndef __MSP430__
+#include <time.h>
+#endif
+
+#include "mem.h"
+
+#ifdef TIMER_ENABLED
+static __fram uint32_t timer_base; // Time at the last boot
+static __fram uint32_t timer_last; // Last time handed out
+static uint32_t timer_start; // Raw time at this boot
+static bool timer_booted;
+
+#if defined(CONFIG_TIMER_VIRTUAL)
+__fram uint32_t timer_virtual;
+
+static uint32_t timer_raw() {
+	return timer_virtual;
+}
+#elif defined(__MSP430__)
+// Timer_A CONFIG_TIMER from SMCLK / 8 in continuous mode, the overflow
+// interrupt extends it to 32 bits so interrupts have to be enabled. The
+// library owns that timer and its TIMERn_A1_VECTOR while the timer is on.
+#ifndef CONFIG_TIMER
+#define CONFIG_TIMER 0
+#endif
+#define TIMER_PASTE(a, n, b) a ## n ## b
+#define TIMER_REG(a, n, b) TIMER_PASTE(a, n, b)
+#define TIMER_CTL TIMER_REG(TA, CONFIG_TIMER, CTL)
+#define TIMER_R TIMER_REG(TA, CONFIG_TIMER, R)
+#define TIMER_IV TIMER_REG(TA, CONFIG_TIMER, IV)
+#define TIMER_IV_TAIFG TIMER_REG(TA, CONFIG_TIMER, IV_TAIFG)
+#define TIMER_VECTOR TIMER_REG(TIMER, CONFIG_TIMER, _A1_VECTOR)
+
+static volatile uint16_t timer_high;
+
+void __attribute__((interrupt(TIMER_VECTOR))) timer_isr(void) {
+	if(TIMER_IV == TIMER_IV_TAIFG) timer_high++;
+}
+
+// With interrupts off an overflow can't be counted between the two reads, one
+// still pending is added if low is from after it
+static uint32_t timer_raw() {
+	uint16_t state = __get_interrupt_state();
+	__disable_interrupt();
+	uint16_t high = timer_high;
+	uint16_t low = TIMER_R;
+	if((TIMER_CTL & TAIFG) && low < 0x8000) high++;
+	__set_interrupt_state(state);
+	return ((uint32_t)high << 16) | low;
+}
+#else
+static uint32_t timer_raw() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * CONFIG_TIMER_HZ +
+		ts.tv_nsec / (1000000000UL / CONFIG_TIMER_HZ);
+}
+#endif
+
+void timer_boot() {
+	if(timer_booted) return;
+#if defined(__MSP430__) && !defined(CONFIG_TIMER_VIRTUAL)
+	TIMER_CTL = TASSEL__SMCLK | ID__8 | MC__CONTINUOUS | TACLR | TAIE;
+#endif
+	timer_start = timer_raw();
+	timer_base = timer_last;
+	timer_booted = true;
+}
+
+uint32_t timer_now() {
+	timer_last = timer_base + (timer_raw() - timer_start);
+	return timer_last;
+}
+#endif
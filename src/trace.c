@@ -0,0 +1,50 @@
+#include "trace.h"
+
+#include <libio/console.h>
+#include <libalpaca/alpaca.h>
+
+#include "mem.h"
+#include "misc.h"
+#include "timer.h"
+
+#ifdef CONFIG_TRACE
+__fram trace_t trace_buf[CONFIG_TRACE_LENGTH];
+__fram uint16_t trace_head;
+static __fram uint16_t trace_epoch;
+
+// Not idempotent on purpose, re-executed transitions show up again
+void trace(uint8_t event, uint16_t uid) {
+	trace_t *t = &trace_buf[trace_head % CONFIG_TRACE_LENGTH];
+	t->time = timer_now();
+	t->uid = uid;
+	t->event = event;
+	t->epoch = trace_epoch;
+	trace_head++;
+}
+
+// Call from the application's init function
+void trace_boot() {
+	timer_boot();
+	trace_epoch++;
+	trace(TRACE_BOOT, CUR_TASK->idx);
+}
+
+void trace_reset() {
+	trace_head = 0;
+	trace_epoch = 0;
+}
+
+// Only with the console, the loop has nothing else to do
+void trace_print() {
+#ifdef CONFIG_CONSOLE
+	uint16_t len = trace_head < CONFIG_TRACE_LENGTH ?
+		trace_head : CONFIG_TRACE_LENGTH;
+	PRINTF("\r\n=========Trace=========");
+	for(uint16_t i = trace_head - len; i != trace_head; i++) {
+		trace_t *t = &trace_buf[i % CONFIG_TRACE_LENGTH];
+		PRINTF("\r\nT %u %u %u %n", t->uid, t->event, t->epoch, t->time);
+	}
+	PRINTF("\r\n=======================");
+#endif
+}
+#endif
@@ -0,0 +1,465 @@
+#!/usr/bin/env python3
+"""Convert a trained network into libdnn-ready weight headers.
+
+The model is described either by an ONNX file or by a NumPy archive plus a
+JSON layer list:
+
+    {
+        "frac_bits": 5,
+        "layers": [
+            {"name": "conv1", "type": "conv", "weights": "conv1_w",
+             "bias": "conv1_b", "layout": "oihw"},
+            {"name": "fc1", "type": "fc", "weights": "fc1_w",
+             "bias": "fc1_b", "layout": "io", "sparse": true}
+        ]
+    }
+
+Layer types are "conv", "depthconv" and "fc". Weights are transposed into the
+layouts the libdnn kernels expect (OIHW for convolutions, rows x cols for fully
+connected layers), quantized to the libfixed format and stored dense or sparse:
+
+    conv/depthconv  sparse.dims = {filters, channels, rows, cols}
+                    sparse.sizes[i] = non-zeros in filter i
+                    sparse.offsets = index of the first non-zero of each
+                    filter, then deltas to the previous non-zero
+    fc              sparse.dims = {rows, cols}
+                    sparse.sizes = CSR row pointer (rows + 1 entries)
+                    sparse.offsets = column of each non-zero
+
+This is what task_s_conv/task_s_depthconv and task_s_fc consume. The "sparse"
+key forces a layer either way; otherwise a layer is stored sparse when its
+density is below --sparse-threshold.
+
+The tool also works out the largest LIBDNN_SHIFT for which no convolution
+overflows with params.shift left at SHIFT (MODEL_SHIFT, or --shift to pick
+one), and then for every convolution the largest params.shift in a build with
+that SHIFT (<LAYER>_SHIFT, and in the image). LEA convolutions shift
+activations by params.shift and coefficients by 2 * SHIFT + 1 - params.shift,
+so a layer shift is only valid with the SHIFT it was worked out for.
+
+Usage:
+    convert.py model.npz layers.json -o model.h
+    convert.py model.onnx -o model.h
+    convert.py model.onnx --image model.bin
+
+--image writes the versioned binary container described in
+src/include/libdnn/model.h instead, which model_load() binds in place.
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+import struct
+import sys
+
+import numpy as np
+
+FIXED_MIN = -(1 << 15)
+FIXED_MAX = (1 << 15) - 1
+
+# Bits of headroom the conv pre-shift and LEA kernels consume: activations are
+# shifted left by params.shift and filter coefficients by the rest of
+# 2 * SHIFT + 1, SHIFT + 1 when params.shift is SHIFT
+LEA_COEFF_EXTRA_SHIFT = 1
+
+
+class Layer(object):
+    def __init__(self, name, kind, weights, bias, sparse=None, act_max=1.0):
+        self.name = name
+        self.kind = kind
+        self.weights = weights
+        self.bias = bias
+        self.sparse = sparse
+        self.act_max = act_max
+
+
+def c_name(name):
+    name = re.sub(r'[^0-9a-zA-Z_]', '_', name)
+    if name[0].isdigit():
+        name = '_' + name
+    return name
+
+
+def to_layout(kind, w, layout):
+    """Transpose weights into the layout the kernels index with."""
+    layout = (layout or '').lower()
+    if kind in ('conv', 'depthconv'):
+        if w.ndim == 3:  # 1-D convolution, treat as a single row
+            # oiw gets h = 1 before w, wio (Keras) h = 1 in front, both
+            # end up [O, I, 1, W]
+            w = w[:, :, np.newaxis, :] if layout in ('', 'oiw') else \
+                w[np.newaxis, :, :, :]
+            layout = 'oihw' if layout in ('', 'oiw') else 'hwio'
+        if layout in ('', 'oihw'):
+            pass
+        elif layout == 'hwio':
+            w = w.transpose(3, 2, 0, 1)
+        elif layout == 'ohwi':
+            w = w.transpose(0, 3, 1, 2)
+        else:
+            raise ValueError('unknown conv layout %s' % layout)
+        if kind == 'depthconv' and w.shape[1] != 1:
+            # Keras stores depthwise kernels as (h, w, channels, 1)
+            w = w.transpose(1, 0, 2, 3)
+    elif kind == 'fc':
+        if layout in ('', 'oi'):
+            pass
+        elif layout == 'io':
+            w = w.T
+        else:
+            raise ValueError('unknown fc layout %s' % layout)
+    else:
+        raise ValueError('unknown layer type %s' % kind)
+    return np.ascontiguousarray(w)
+
+
+def quantize(x, frac_bits):
+    q = np.round(np.asarray(x, dtype=np.float64) * (1 << frac_bits))
+    clipped = int(np.count_nonzero((q < FIXED_MIN) | (q > FIXED_MAX)))
+    return np.clip(q, FIXED_MIN, FIXED_MAX).astype(np.int16), clipped
+
+
+def sparse_conv(q):
+    """Encode each filter as a run of non-zeros with delta offsets."""
+    filters = q.reshape(q.shape[0], -1)
+    data, offsets, sizes = [], [], []
+    for f in filters:
+        idx = np.flatnonzero(f)
+        sizes.append(len(idx))
+        prev = 0
+        for n, i in enumerate(idx):
+            offsets.append(int(i) if n == 0 else int(i - prev))
+            data.append(int(f[i]))
+            prev = i
+    return data, offsets, sizes
+
+
+def sparse_fc(q):
+    """Encode a rows x cols matrix as CSR."""
+    data, offsets, sizes = [], [], [0]
+    for row in q:
+        idx = np.flatnonzero(row)
+        offsets.extend(int(i) for i in idx)
+        data.extend(int(row[i]) for i in idx)
+        sizes.append(len(data))
+    return data, offsets, sizes
+
+
+def value_bits(q, act_max, frac_bits):
+    """Bits the largest weight and the largest activation take."""
+    w_max = int(np.max(np.abs(q.astype(np.int32)))) if q.size else 0
+    a_max = int(math.ceil(act_max * (1 << frac_bits)))
+    return max(w_max, 1).bit_length(), max(a_max, 1).bit_length()
+
+
+def max_shift(q, act_max, frac_bits):
+    """Largest SHIFT for which neither the weights nor activations overflow
+    with params.shift at SHIFT."""
+    w_bits, a_bits = value_bits(q, act_max, frac_bits)
+    return max(0, min(15 - w_bits - LEA_COEFF_EXTRA_SHIFT, 15 - a_bits))
+
+
+def layer_shift(q, act_max, frac_bits, base):
+    """Largest params.shift in a build with SHIFT base for which neither the
+    activations nor the coefficients, shifted by 2 * base + 1 - params.shift,
+    overflow. None when no shift fits."""
+    w_bits, a_bits = value_bits(q, act_max, frac_bits)
+    product = 2 * base + LEA_COEFF_EXTRA_SHIFT
+    hi = min(15 - a_bits, product)
+    if hi < max(0, product - (15 - w_bits)):
+        return None
+    return hi
+
+
+class Tensor(object):
+    """A quantized tensor ready to be emitted as a mat_t."""
+
+    def __init__(self, name, dims, data, sparse=None):
+        self.name = name
+        self.dims = list(dims)
+        self.data = list(data)
+        # (sparse dims, offsets, sizes) when the tensor is stored sparse
+        self.sparse = sparse
+
+
+LAYER_TYPES = {'conv': 0, 'depthconv': 1, 'fc': 2}
+
+MODEL_MAGIC = 0x4E44
+MODEL_VERSION = 1
+MODEL_ALIGN = 4
+MODEL_MAX_DIMS = 4
+MODEL_NONE = 0xFFFF
+MODEL_TENSOR_SPARSE = 0x1
+MODEL_LAYER_SHIFTED = 0x1
+
+HEADER = struct.Struct('<HHHHIHH')
+LAYER = struct.Struct('<BBHHH')
+TENSOR = struct.Struct('<HH%dHH%dHHIII' % (MODEL_MAX_DIMS, MODEL_MAX_DIMS))
+
+
+def convert(layers, frac_bits, sparse_threshold, base=None):
+    """Returns the tensors, a (type, weights, bias, shift) table and the SHIFT
+    the layer shifts are for, base or else the largest one all convs fit."""
+    tensors = []
+    table = []
+    convs = []
+    for layer in layers:
+        weights = len(tensors)
+        bias = MODEL_NONE
+        q, clipped = quantize(layer.weights, frac_bits)
+        if clipped:
+            sys.stderr.write('warning: %s: %u weights saturated\n' %
+                             (layer.name, clipped))
+        density = np.count_nonzero(q) / float(q.size)
+        sparse = layer.sparse
+        if sparse is None:
+            sparse = density < sparse_threshold
+        name = c_name(layer.name)
+        if sparse:
+            if layer.kind == 'fc':
+                data, offsets, sizes = sparse_fc(q)
+            else:
+                data, offsets, sizes = sparse_conv(q)
+            # Kernels peek one offset past the last non-zero
+            offsets.append(0)
+            tensors.append(Tensor(name + '_w', [len(data)], data,
+                                  (list(q.shape), offsets, sizes)))
+        else:
+            tensors.append(Tensor(name + '_w', q.shape, q.flatten()))
+        if layer.bias is not None:
+            b, clipped = quantize(layer.bias, frac_bits)
+            if clipped:
+                sys.stderr.write('warning: %s: %u biases saturated\n' %
+                                 (layer.name, clipped))
+            dims = [b.size, 1] if layer.kind == 'fc' else [b.size]
+            bias = len(tensors)
+            tensors.append(Tensor(name + '_b', dims, b.flatten()))
+        if layer.kind in ('conv', 'depthconv'):
+            convs.append((len(table), layer, q))
+        table.append((LAYER_TYPES[layer.kind], weights, bias, None))
+        sys.stderr.write('%s: %s %s density %.3f -> %s\n' % (
+            layer.name, layer.kind, 'x'.join(str(d) for d in q.shape),
+            density, 'sparse' if sparse else 'dense'))
+    if not convs:
+        return tensors, table, base
+    if base is None:
+        base = min(max_shift(q, layer.act_max, frac_bits)
+                   for _, layer, q in convs)
+    for i, layer, q in convs:
+        s = layer_shift(q, layer.act_max, frac_bits, base)
+        if s is None:
+            sys.stderr.write('warning: %s: no shift fits SHIFT %u\n' %
+                             (layer.name, base))
+            continue
+        table[i] = table[i][:3] + (s,)
+    return tensors, table, base
+
+
+def fmt_array(values, per_line=12):
+    values = [str(int(v)) for v in values]
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('\t' + ', '.join(values[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in bytearray(data):
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def pad_dims(dims):
+    if len(dims) > MODEL_MAX_DIMS:
+        raise ValueError('too many dims %s' % dims)
+    return list(dims) + [0] * (MODEL_MAX_DIMS - len(dims))
+
+
+def emit_image(tensors, table):
+    """Pack tensors into the container format of libdnn/model.h."""
+    blobs = bytearray()
+    base = HEADER.size + LAYER.size * len(table) + TENSOR.size * len(tensors)
+
+    def blob(values, fmt):
+        while (base + len(blobs)) % MODEL_ALIGN:
+            blobs.append(0)
+        offset = base + len(blobs)
+        blobs.extend(struct.pack('<%d%s' % (len(values), fmt), *values))
+        return offset
+
+    descs = bytearray()
+    for t in tensors:
+        data = blob(t.data, 'h')
+        if t.sparse is not None:
+            sdims, offsets, sizes = t.sparse
+            descs += TENSOR.pack(MODEL_TENSOR_SPARSE, len(t.dims),
+                                 *(pad_dims(t.dims) + [len(sdims)] +
+                                   pad_dims(sdims) +
+                                   [0, data, blob(offsets, 'H'),
+                                    blob(sizes, 'H')]))
+        else:
+            descs += TENSOR.pack(0, len(t.dims),
+                                 *(pad_dims(t.dims) + [0] +
+                                   pad_dims([]) + [0, data, 0, 0]))
+    layers = bytearray()
+    for kind, weights, bias, shift in table:
+        if shift is None:
+            layers += LAYER.pack(kind, 0, weights, bias, 0)
+        else:
+            layers += LAYER.pack(kind, MODEL_LAYER_SHIFTED, weights, bias,
+                                 shift)
+    body = bytes(layers + descs + blobs)
+    header = HEADER.pack(MODEL_MAGIC, MODEL_VERSION, len(table), len(tensors),
+                         HEADER.size + len(body), crc16(body), 0)
+    return header + body
+
+
+def emit_header(tensors, table, shift, frac_bits, guard):
+    out = []
+    out.append('#ifndef %s' % guard)
+    out.append('#define %s' % guard)
+    out.append('// Generated by tools/convert.py, do not edit')
+    out.append('#include <stdint.h>')
+    out.append('#include <libfixed/fixed.h>')
+    out.append('#include <libmat/mat.h>')
+    out.append('#include <libdnn/mem.h>')
+    out.append('')
+    out.append('#define MODEL_FRAC_BITS %u' % frac_bits)
+    if shift is not None:
+        out.append('// Build libdnn with LIBDNN_SHIFT=%u, the layer shifts '
+                   'are for it' % shift)
+        out.append('#define MODEL_SHIFT %u' % shift)
+    for kind, weights, bias, s in table:
+        if s is not None:
+            out.append('#define %s_SHIFT %u' % (
+                tensors[weights].name[:-len('_w')].upper(), s))
+    for t in tensors:
+        out.append('')
+        out.append('__ro_hifram fixed %s[%u] = {' % (t.name, max(len(t.data), 1)))
+        out.append(fmt_array(t.data or [0]))
+        out.append('};')
+        if t.sparse is not None:
+            sdims, offsets, sizes = t.sparse
+            out.append('')
+            out.append('__ro_hifram uint16_t %s_offsets[%u] = {' %
+                       (t.name, len(offsets)))
+            out.append(fmt_array(offsets))
+            out.append('};')
+            out.append('')
+            out.append('__ro_hifram uint16_t %s_sizes[%u] = {' %
+                       (t.name, len(sizes)))
+            out.append(fmt_array(sizes))
+            out.append('};')
+        out.append('')
+        out.append('__fram mat_t mat_%s = {' % t.name)
+        out.append('\t.dims = {%s},' % ', '.join(str(d) for d in t.dims))
+        out.append('\t.len_dims = %u,' % len(t.dims))
+        out.append('\t.data = %s,' % t.name)
+        if t.sparse is not None:
+            sdims, offsets, sizes = t.sparse
+            out.append('\t.sparse = {')
+            out.append('\t\t.dims = {%s},' % ', '.join(str(d) for d in sdims))
+            out.append('\t\t.len_dims = %u,' % len(sdims))
+            out.append('\t\t.offsets = %s_offsets,' % t.name)
+            out.append('\t\t.sizes = %s_sizes,' % t.name)
+            out.append('\t},')
+        out.append('};')
+    out.append('')
+    out.append('#endif')
+    return '\n'.join(out) + '\n'
+
+
+def load_npz(path, spec_path):
+    arrays = np.load(path)
+    with open(spec_path) as f:
+        spec = json.load(f)
+    layers = []
+    for n, l in enumerate(spec['layers']):
+        kind = l['type']
+        w = to_layout(kind, arrays[l['weights']], l.get('layout'))
+        b = arrays[l['bias']] if l.get('bias') else None
+        layers.append(Layer(l.get('name', 'layer%u' % n), kind, w, b,
+                            l.get('sparse'), l.get('act_max', 1.0)))
+    return layers, spec.get('frac_bits')
+
+
+def load_onnx(path):
+    import onnx
+    from onnx import numpy_helper
+
+    model = onnx.load(path)
+    inits = {i.name: numpy_helper.to_array(i)
+             for i in model.graph.initializer}
+    layers = []
+    for n, node in enumerate(model.graph.node):
+        attrs = {a.name: onnx.helper.get_attribute_value(a)
+                 for a in node.attribute}
+        name = node.name or '%s%u' % (node.op_type.lower(), n)
+        if node.op_type == 'Conv':
+            w = inits[node.input[1]]
+            b = inits[node.input[2]] if len(node.input) > 2 else None
+            kind = 'depthconv' if attrs.get('group', 1) > 1 else 'conv'
+            layers.append(Layer(name, kind, to_layout(kind, w, 'oihw'), b))
+        elif node.op_type == 'Gemm':
+            w = inits[node.input[1]]
+            b = inits[node.input[2]] if len(node.input) > 2 else None
+            layout = 'oi' if attrs.get('transB', 0) else 'io'
+            layers.append(Layer(name, 'fc', to_layout('fc', w, layout), b))
+        elif node.op_type == 'MatMul' and node.input[1] in inits:
+            w = inits[node.input[1]]
+            layers.append(Layer(name, 'fc', to_layout('fc', w, 'io'), None))
+    return layers
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert a trained network into libdnn weight headers')
+    parser.add_argument('model', help='.onnx file or .npz archive')
+    parser.add_argument('layers', nargs='?',
+                        help='JSON layer list (required for .npz)')
+    parser.add_argument('-o', '--output', help='header to write')
+    parser.add_argument('--image', help='binary model image to write')
+    parser.add_argument('--frac-bits', type=int, default=None,
+                        help='fractional bits of libfixed (F_N), default 5')
+    parser.add_argument('--sparse-threshold', type=float, default=0.5,
+                        help='store layers below this density sparse')
+    parser.add_argument('--shift', type=int, default=None,
+                        help='LIBDNN_SHIFT to work the layer shifts out for, '
+                        'default the largest one that fits')
+    args = parser.parse_args()
+    if args.output is None and args.image is None:
+        parser.error('one of --output or --image is required')
+
+    frac_bits = None
+    if args.model.endswith('.onnx'):
+        layers = load_onnx(args.model)
+    else:
+        if args.layers is None:
+            parser.error('a layer list is required for %s' % args.model)
+        layers, frac_bits = load_npz(args.model, args.layers)
+    if args.frac_bits is not None:
+        frac_bits = args.frac_bits
+    if frac_bits is None:
+        frac_bits = 5
+
+    tensors, table, shift = convert(layers, frac_bits, args.sparse_threshold,
+                                    args.shift)
+    if shift is not None:
+        sys.stderr.write('SHIFT: %u\n' % shift)
+    if args.output is not None:
+        guard = c_name(os.path.basename(args.output)).upper()
+        with open(args.output, 'w') as f:
+            f.write(emit_header(tensors, table, shift, frac_bits, guard))
+    if args.image is not None:
+        with open(args.image, 'wb') as f:
+            f.write(emit_image(tensors, table))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Estimate energy and latency of an inference from a libdnn profile dump.
+
+Input is console output of a LIBDNN_PROFILE=1 build containing the block
+printed by prof_print():
+
+    =========Stats=========
+    [{ "backend": ..., "target": ..., "overall": {...}, "sections": {...} }]
+    =======================
+
+Each counter is priced with a cost table entry
+
+    "name": [cycles per invoc, cycles per op, extra nJ per op]
+
+energy = cycles * nj_per_cycle + extra. The extra term covers costs that do
+not scale with the clock, mostly FRAM accesses past the cache. The built-in
+tables hold rough datasheet numbers. Measure a few kernels on the board and
+pass a JSON table with --table to calibrate; keys that are left out fall back
+to the built-in entry.
+
+Builds with LIBDNN_PROFILE_MEM report memory traffic per region. When those
+counters are present the hand-placed ld/st counters are skipped so accesses
+are not charged twice.
+
+The harvester options turn the estimate into a sizing check: --harvest-uw
+gives the sustained inference rate, and --cap-uf with --v-on/--v-off gives the
+energy per charge cycle and the number of reboots an inference will take.
+
+Usage:
+    energy.py console.log
+    energy.py console.log --table fr5994_measured.json --harvest-uw 150
+    energy.py console.log --cap-uf 47 --v-on 2.4 --v-off 1.8
+"""
+
+import argparse
+import json
+import sys
+
+START = '=========Stats========='
+END = '======================='
+
+# MSP430FR5994 at 16 MHz, one FRAM wait state, about 120 uA/MHz at 3 V
+MSP430FR5994 = {
+    'clock_hz': 16e6,
+    'nj_per_cycle': 0.36,
+    'ops': {
+        'ld': [0, 2, 0.2], 'st': [0, 2, 0.2],
+        'add': [0, 1, 0], 'mul': [0, 8, 0], 'inc': [0, 1, 0],
+        'loop_inc': [0, 2, 0], 'loop_add': [0, 2, 0],
+        'F_ADD': [0, 1, 0], 'F_MUL': [0, 10, 0],
+        'MAT_GET_1D': [0, 6, 0], 'MAT_GET_2D': [0, 20, 0],
+        'MAT_GET_3D': [0, 35, 0], 'MAT_SET_2D': [0, 20, 0],
+        'MAT_SET_3D': [0, 35, 0],
+        'DMA': [30, 2, 0.2],
+        'LEA_ADD': [80, 0.5, 0], 'LEA_FIR': [80, 0.5, 0],
+        'LEA_MAC': [80, 0.5, 0],
+        # LIBDNN_PROFILE_MEM, ops are bytes, gbuf data is written twice
+        'SRAM_LD': [0, 0.5, 0], 'SRAM_ST': [0, 0.5, 0],
+        'LEARAM_LD': [0, 0.5, 0], 'LEARAM_ST': [0, 0.5, 0],
+        'FRAM_LD': [0, 1, 0.1], 'FRAM_ST': [0, 1, 0.1],
+        'HIFRAM_LD': [0, 1.5, 0.1], 'HIFRAM_ST': [0, 1.5, 0.1],
+        'SRAM_GBUF': [20, 2, 0.1], 'LEARAM_GBUF': [20, 2, 0.1],
+        'FRAM_GBUF': [20, 2, 0.2], 'HIFRAM_GBUF': [20, 2.5, 0.2],
+    },
+}
+
+# Host builds only give op counts, price them like the MSP430
+TABLES = {'msp430fr5994': MSP430FR5994, 'msp430': MSP430FR5994,
+          'host': MSP430FR5994}
+
+MEM_REGIONS = ('SRAM', 'LEARAM', 'FRAM', 'HIFRAM')
+
+
+def read_dump(f):
+    """Returns the parsed prof_print() output, the last one in the log."""
+    text, inside, dumps = [], False, []
+    for line in f:
+        line = line.strip()
+        if line == START:
+            text, inside = [], True
+        elif line == END and inside:
+            dumps.append(json.loads(' '.join(text)))
+            inside = False
+        elif inside:
+            text.append(line)
+    if not dumps:
+        sys.exit('no profile dump found')
+    dump = dumps[-1]
+    return dump[0] if isinstance(dump, list) else dump
+
+
+def load_table(target, path):
+    table = TABLES.get(target, MSP430FR5994)
+    table = dict(table, ops=dict(table['ops']))
+    if path:
+        with open(path) as f:
+            custom = json.load(f)
+        table['ops'].update(custom.pop('ops', {}))
+        table.update(custom)
+    return table
+
+
+def estimate(stats, table):
+    """Returns (cycles, nJ, {counter: nJ}) for one stats object."""
+    has_mem = any(k.startswith(MEM_REGIONS) for k in stats)
+    cycles, extra, parts = 0.0, 0.0, {}
+    for name, stat in stats.items():
+        if has_mem and name in ('ld', 'st'):
+            continue
+        cost = table['ops'].get(name)
+        if cost is None:
+            continue
+        c = cost[0] * stat['invocs'] + cost[1] * stat['ops']
+        e = cost[2] * stat['ops']
+        cycles += c
+        extra += e
+        parts[name] = c * table['nj_per_cycle'] + e
+    return cycles, cycles * table['nj_per_cycle'] + extra, parts
+
+
+def main():
+    parser = argparse.ArgumentParser(description='libdnn energy estimate')
+    parser.add_argument('input', help='console log with a prof_print() dump')
+    parser.add_argument('--table', help='JSON cost table overrides')
+    parser.add_argument('--target', help='cost table to use, default from dump')
+    parser.add_argument('--top', type=int, default=3,
+                        help='most expensive counters listed per layer')
+    parser.add_argument('--harvest-uw', type=float,
+                        help='average harvested power in uW')
+    parser.add_argument('--cap-uf', type=float, help='storage capacitor in uF')
+    parser.add_argument('--v-on', type=float, default=2.4,
+                        help='turn on voltage')
+    parser.add_argument('--v-off', type=float, default=1.8,
+                        help='brown out voltage')
+    parser.add_argument('--json', action='store_true',
+                        help='print the estimate as JSON')
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        dump = read_dump(f)
+    target = args.target or dump.get('target') or 'msp430fr5994'
+    table = load_table(target, args.table)
+    hz = table['clock_hz']
+
+    rows = []
+    for name, section in dump.get('sections', {}).items():
+        cycles, nj, parts = estimate(section['stats'], table)
+        rows.append((name, cycles, nj, parts))
+    cycles, nj, parts = estimate(dump.get('overall', {}), table)
+
+    result = {
+        'backend': dump.get('backend', ''), 'target': target,
+        'layers': [{'name': n, 'cycles': c, 'ms': c / hz * 1e3,
+                    'uJ': e / 1e3} for n, c, e, _ in rows],
+        'total': {'cycles': cycles, 'ms': cycles / hz * 1e3, 'uJ': nj / 1e3},
+    }
+    if args.harvest_uw:
+        result['inferences_per_s'] = args.harvest_uw / (nj / 1e3)
+    if args.cap_uf:
+        charge_uj = 0.5 * args.cap_uf * (args.v_on ** 2 - args.v_off ** 2)
+        result['charge_uJ'] = charge_uj
+        result['reboots'] = int(nj / 1e3 // charge_uj)
+
+    if args.json:
+        print(json.dumps(result, indent=2))
+        return
+
+    print('backend %s, target %s' % (result['backend'] or '?', target))
+    print('%-16s %12s %10s %10s  %s' % ('layer', 'cycles', 'ms', 'uJ', 'top'))
+    for name, c, e, p in rows:
+        top = sorted(p, key=lambda k: -p[k])[:args.top]
+        print('%-16s %12.0f %10.3f %10.3f  %s' % (
+            name, c, c / hz * 1e3, e / 1e3, ' '.join(top)))
+    print('%-16s %12.0f %10.3f %10.3f' % (
+        'total', cycles, cycles / hz * 1e3, nj / 1e3))
+    if 'inferences_per_s' in result:
+        print('%.3f inferences/s at %.1f uW' % (
+            result['inferences_per_s'], args.harvest_uw))
+    if 'charge_uJ' in result:
+        print('%.2f uJ per charge cycle, about %u reboots per inference' % (
+            result['charge_uJ'], result['reboots']))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Decode a libdnn task trace (LIBDNN_TRACE builds).
+
+Input is either console output containing the lines printed by trace_print():
+
+    T <uid> <event> <epoch> <time>
+
+or, with --raw, a memory dump of trace_buf (8 byte little endian entries)
+read off the device or the simulator, in which case --head gives the value
+of trace_head so the ring can be put back in order.
+
+Time between two events is charged to the task that was running, i.e. the
+target of the last transition, or the task resumed by the last boot. Time
+across a reboot is charged to the task that was interrupted.
+
+Usage:
+    trace_decode.py console.log
+    trace_decode.py --raw trace.bin --head 1234 --tick-hz 1000000
+"""
+
+import argparse
+import collections
+import re
+import struct
+import sys
+
+TRANSITION, CLEANUP, BOOT = 0, 1, 2
+EVENTS = {TRANSITION: 'transition', CLEANUP: 'cleanup', BOOT: 'boot'}
+
+# Task UIDs of libdnn itself, see the TASK_UID_*_OFFSET defines
+# The BLAS and NN ranges overlap, those uids can't be told apart
+NAMES = {
+    10: 'task_ds_zero', 11: 'task_ds_add', 12: 'task_ds_mul',
+    13: 'task_ds_div', 14: 'task_dm_add', 15: 'task_dm_mul',
+    16: 'task_dm_conv', 17: 'task_dmv_mul', 18: 'task_sm_mul', 19: 'task_svm_mul',
+    20: 'task_sm_conv|task_d_conv', 21: 'task_d_depthconv',
+    22: 'task_s_conv|task_calibrate', 23: 'task_s_depthconv',
+    24: 'task_d_fc', 25: 'task_s_fc', 26: 'task_exit_check',
+    50: 'task_norm',
+    61: 'task_pool', 62: 'task_relu', 63: 'task_filter', 64: 'task_transpose',
+    70: 'task_model_commit',
+    80: 'task_svm_mul_stream',
+    90: 'task_delta_mul',
+    100: 'task_svsv_mul', 101: 'task_smm_mul', 102: 'task_relu_pack',
+    404: 'task_cleanup',
+}
+
+ENTRY = struct.Struct('<IHBB')
+LINE = re.compile(r'^T (\d+) (\d+) (\d+) (\d+)\s*$')
+
+
+def read_text(f):
+    for line in f:
+        m = LINE.match(line.strip())
+        if m:
+            yield tuple(int(g) for g in m.groups())
+
+
+def read_raw(data, head):
+    n = len(data) // ENTRY.size
+    count = min(head, n)
+    for i in range(head - count, head):
+        time, uid, event, epoch = ENTRY.unpack_from(data, (i % n) * ENTRY.size)
+        yield uid, event, epoch, time
+
+
+def unwrap(entries):
+    """Unwraps the 8 bit epoch, returns (uid, event, epoch, time)."""
+    base, last = 0, None
+    for uid, event, epoch, time in entries:
+        if last is not None and epoch < last:
+            base += 256
+        last = epoch
+        yield uid, event, base + epoch, time
+
+
+def load_names(path):
+    names = dict(NAMES)
+    if path:
+        with open(path) as f:
+            for line in f:
+                parts = line.split()
+                if len(parts) >= 2 and not line.startswith('#'):
+                    names[int(parts[0], 0)] = parts[1]
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a libdnn trace')
+    parser.add_argument('input', help='console log, or raw dump with --raw')
+    parser.add_argument('--raw', action='store_true',
+                        help='input is a memory dump of trace_buf')
+    parser.add_argument('--head', type=int, default=None,
+                        help='trace_head at the time of the dump')
+    parser.add_argument('--names', help='extra "uid name" lines for tasks')
+    parser.add_argument('--tick-hz', type=float, default=None,
+                        help='LIBDNN_TIMER_HZ, report seconds')
+    parser.add_argument('--timeline', action='store_true',
+                        help='print every event')
+    args = parser.parse_args()
+
+    names = load_names(args.names)
+    if args.raw:
+        with open(args.input, 'rb') as f:
+            data = f.read()
+        head = args.head if args.head is not None else len(data) // ENTRY.size
+        entries = list(unwrap(read_raw(data, head)))
+    else:
+        with open(args.input) as f:
+            entries = list(unwrap(read_text(f)))
+    if not entries:
+        sys.exit('no trace entries found')
+
+    def name(uid):
+        return names.get(uid, 'uid_%u' % uid)
+
+    def fmt_time(t):
+        return '%.6f' % (t / args.tick_hz) if args.tick_hz else str(t)
+
+    entered = collections.Counter()
+    completed = collections.Counter()
+    interrupted = collections.Counter()
+    time = collections.Counter()
+    running = None
+    prev = None
+    for uid, event, epoch, t in entries:
+        if args.timeline:
+            print('%s epoch %u %-10s %s' % (fmt_time(t), epoch, EVENTS.get(
+                event, event), name(uid)))
+        if running is not None and prev is not None and t >= prev:
+            time[running] += t - prev
+        if event == TRANSITION:
+            entered[uid] += 1
+            running = uid
+        elif event == CLEANUP:
+            completed[uid] += 1
+        elif event == BOOT:
+            if running is not None:
+                interrupted[running] += 1
+            running = uid
+        prev = t
+
+    boots = sum(1 for e in entries if e[1] == BOOT)
+    print('%u events, %u reboots' % (len(entries), boots))
+    print('%-24s %8s %8s %8s %12s' % (
+        'task', 'entries', 'done', 'reboots', 'time'))
+    for uid in sorted(set(entered) | set(completed) | set(time),
+                      key=lambda u: -time[u]):
+        print('%-24s %8u %8u %8u %12s' % (
+            name(uid), entered[uid], completed[uid], interrupted[uid],
+            fmt_time(time[uid])))
+
+
+if __name__ == '__main__':
+    main()